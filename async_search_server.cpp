@@ -0,0 +1,37 @@
+#include "async_search_server.h"
+
+#include <execution>
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t thread_count)
+    : search_server_(search_server)
+    , tasks_(ASYNC_QUEUE_CAPACITY) {
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] {
+            while (auto task = tasks_.Pop()) {
+                (*task)();
+            }
+        });
+    }
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    tasks_.Close();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+AsyncSearch AsyncSearchServer::FindTopDocuments(std::string raw_query, DocumentStatus status, Clock::duration timeout) {
+    AsyncSearch search;
+    search.context = std::make_shared<SearchContext>(Clock::now() + timeout);
+    std::packaged_task<SearchResult()> task([this, raw_query = std::move(raw_query), status, context = search.context] {
+        return search_server_.FindTopDocumentsWithin(std::execution::seq, raw_query, status, *context);
+    });
+    search.result = task.get_future();
+    tasks_.Push(std::move(task));
+    return search;
+}
+
+AsyncSearch AsyncSearchServer::FindTopDocuments(std::string raw_query, Clock::duration timeout) {
+    return FindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL, timeout);
+}
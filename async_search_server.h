@@ -0,0 +1,46 @@
+#pragma once
+#include "bounded_queue.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t ASYNC_QUEUE_CAPACITY = 1024;
+
+// Pending query of AsyncSearchServer
+struct AsyncSearch {
+    std::future<SearchResult> result;
+    std::shared_ptr<SearchContext> context;
+
+    // The query stops at its next check and returns the documents scored so far
+    void Cancel() {
+        context->Cancel();
+    }
+};
+
+// Runs queries of a search server on a pool of worker threads. Every query has a deadline
+// counted from its submission, so time spent waiting in the queue is part of the budget.
+// Each query is searched sequentially, the parallelism comes from running many of them.
+// The search server must outlive this object and must not be modified while queries run
+class AsyncSearchServer {
+public:
+    using Clock = SearchContext::Clock;
+
+    explicit AsyncSearchServer(const SearchServer& search_server,
+                               size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+    // Finishes the queued queries
+    ~AsyncSearchServer();
+
+    // Blocks while ASYNC_QUEUE_CAPACITY queries are waiting
+    AsyncSearch FindTopDocuments(std::string raw_query, DocumentStatus status, Clock::duration timeout);
+    AsyncSearch FindTopDocuments(std::string raw_query, Clock::duration timeout);
+
+private:
+    const SearchServer& search_server_;
+    BoundedQueue<std::packaged_task<SearchResult()>> tasks_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,80 @@
+#include "auto_execution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ExecutionThresholds {
+    size_t thread_count = 1;
+    size_t min_parallel_cost = std::numeric_limits<size_t>::max();
+};
+
+static ExecutionThresholds CalibrateThresholds() {
+    using Clock = std::chrono::steady_clock;
+    const auto elapsed_seconds = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    ExecutionThresholds thresholds;
+    thresholds.thread_count = std::max(1u, std::thread::hardware_concurrency());
+    if (thresholds.thread_count == 1) {
+        return thresholds;
+    }
+
+    // Time of scoring one posting: relevance accumulated in a map as FindAllDocuments does
+    const int posting_count = 1 << 14;
+    std::map<int, double> document_to_relevance;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < posting_count; ++i) {
+        document_to_relevance[(i * 7919) % posting_count] += 1.0;
+    }
+    const double posting_seconds = elapsed_seconds(start) / posting_count;
+
+    // Fixed cost of starting a parallel algorithm, the best of several runs
+    std::vector<int> tasks(thresholds.thread_count);
+    double parallel_seconds = std::numeric_limits<double>::max();
+    for (int run = 0; run < 8; ++run) {
+        start = Clock::now();
+        std::for_each(std::execution::par, tasks.begin(), tasks.end(), [](int& task) {
+            ++task;
+        });
+        parallel_seconds = std::min(parallel_seconds, elapsed_seconds(start));
+    }
+
+    // Splitting the work saves (1 - 1 / thread_count) of the postings time, it has to cover
+    // the start of the parallel algorithm and about as much again for locking the ConcurrentMap
+    const double saved_share = 1.0 - 1.0 / thresholds.thread_count;
+    thresholds.min_parallel_cost = static_cast<size_t>(2.0 * parallel_seconds / (posting_seconds * saved_share)) + 1;
+    return thresholds;
+}
+
+static const ExecutionThresholds& GetExecutionThresholds() {
+    static std::once_flag calibrated;
+    static ExecutionThresholds thresholds;
+    std::call_once(calibrated, [] {
+        thresholds = CalibrateThresholds();
+    });
+    return thresholds;
+}
+
+void CalibrateAutoExecution() {
+    GetExecutionThresholds();
+}
+
+ExecutionPlan PlanExecution(size_t cost, size_t task_count) {
+    const ExecutionThresholds& thresholds = GetExecutionThresholds();
+    ExecutionPlan plan;
+    if (cost >= thresholds.min_parallel_cost) {
+        plan.parallelism = std::max<size_t>(1, std::min(task_count, thresholds.thread_count));
+    }
+    return plan;
+}
+
+size_t GetParallelCostThreshold() {
+    return GetExecutionThresholds().min_parallel_cost;
+}
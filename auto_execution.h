@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+// Execution policy tag: the search server estimates the cost of the call from the
+// posting list lengths and runs it sequentially or in parallel
+struct AutoExecutionPolicy {
+};
+
+const AutoExecutionPolicy AUTO_EXECUTION{};
+
+struct ExecutionPlan {
+    // Number of concurrently running tasks worth using, 1 for sequential execution
+    size_t parallelism = 1;
+};
+
+// Measures the break-even cost of parallel execution with a micro-benchmark. Runs once per
+// process, later calls return at once. SearchServer calls it on construction
+void CalibrateAutoExecution();
+
+// cost is the number of postings a call visits, task_count the number of independent parts
+// it splits into (query words, posting lists). Calibrates on the first call if needed
+ExecutionPlan PlanExecution(size_t cost, size_t task_count);
+
+// Cost from which parallel execution pays off on this machine
+size_t GetParallelCostThreshold();
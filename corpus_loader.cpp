@@ -0,0 +1,205 @@
+#include "corpus_loader.h"
+#include "bounded_queue.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+
+using namespace std::literals;
+
+struct TokenizedDocument {
+    int id;
+    DocumentStatus status;
+    std::vector<int> ratings;
+    NormalizedText normalized;
+};
+
+struct TokenizedChunk {
+    // Words point into data, a moved vector keeps its buffer
+    std::vector<char> data;
+    std::vector<TokenizedDocument> documents;
+};
+
+static std::string_view NextField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw std::invalid_argument("Corpus line has too few fields: "s + std::string(line));
+    }
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+static int ParseInt(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number in corpus: "s + std::string(text));
+    }
+    return value;
+}
+
+static DocumentStatus ParseStatus(std::string_view text) {
+    if (text == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("Invalid document status in corpus: "s + std::string(text));
+}
+
+static TokenizedDocument ParseDocument(const SearchServer& search_server, std::string_view line) {
+    TokenizedDocument document;
+    document.id = ParseInt(NextField(line));
+    document.status = ParseStatus(NextField(line));
+    for (std::string_view rating : SplitIntoWords(NextField(line))) {
+        document.ratings.push_back(ParseInt(rating));
+    }
+    document.normalized = search_server.TokenizeDocument(line);
+    return document;
+}
+
+// Stage 1: splits the input into chunks of whole lines
+static void ReadChunks(std::istream& input, BoundedQueue<std::vector<char>>& chunks) {
+    std::vector<char> carry;
+    while (true) {
+        std::vector<char> chunk = std::move(carry);
+        carry.clear();
+        const size_t carried = chunk.size();
+        chunk.resize(carried + CORPUS_CHUNK_SIZE);
+        input.read(chunk.data() + carried, CORPUS_CHUNK_SIZE);
+        chunk.resize(carried + input.gcount());
+        if (!input) {
+            if (!chunk.empty()) {
+                chunks.Push(std::move(chunk));
+            }
+            return;
+        }
+
+        const auto last_line_end = std::find(chunk.rbegin(), chunk.rend(), '\n').base();
+        if (last_line_end == chunk.begin()) {
+            // A line longer than a chunk: keep reading it
+            carry = std::move(chunk);
+            continue;
+        }
+        carry.assign(last_line_end, chunk.end());
+        chunk.erase(last_line_end, chunk.end());
+        if (!chunks.Push(std::move(chunk))) {
+            return;
+        }
+    }
+}
+
+// Stage 2: parses records and splits texts into words, only words changed by normalization are copied
+static void TokenizeChunks(const SearchServer& search_server, BoundedQueue<std::vector<char>>& chunks,
+                           BoundedQueue<TokenizedChunk>& tokenized_chunks) {
+    while (auto chunk = chunks.Pop()) {
+        TokenizedChunk tokenized_chunk;
+        tokenized_chunk.data = std::move(*chunk);
+        std::string_view text(tokenized_chunk.data.data(), tokenized_chunk.data.size());
+        while (!text.empty()) {
+            const size_t line_end = std::min(text.find('\n'), text.size());
+            std::string_view line = text.substr(0, line_end);
+            text.remove_prefix(std::min(line_end + 1, text.size()));
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                tokenized_chunk.documents.push_back(ParseDocument(search_server, line));
+            }
+        }
+        if (!tokenized_chunks.Push(std::move(tokenized_chunk))) {
+            return;
+        }
+    }
+}
+
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, std::istream& input, std::ostream* progress) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start_time = Clock::now();
+
+    BoundedQueue<std::vector<char>> chunks(CORPUS_QUEUE_CAPACITY);
+    BoundedQueue<TokenizedChunk> tokenized_chunks(CORPUS_QUEUE_CAPACITY);
+    // Whichever stage stops first closes both queues, so that no stage waits forever
+    const auto close_queues = [&chunks, &tokenized_chunks] {
+        chunks.Close();
+        tokenized_chunks.Close();
+    };
+
+    auto reader = std::async(std::launch::async, [&input, &chunks, &close_queues] {
+        try {
+            ReadChunks(input, chunks);
+        } catch (...) {
+            close_queues();
+            throw;
+        }
+        chunks.Close();
+    });
+    auto tokenizer = std::async(std::launch::async, [&search_server, &chunks, &tokenized_chunks, &close_queues] {
+        try {
+            TokenizeChunks(search_server, chunks, tokenized_chunks);
+        } catch (...) {
+            close_queues();
+            throw;
+        }
+        tokenized_chunks.Close();
+    });
+
+    CorpusLoadStatistics statistics;
+    const auto elapsed_seconds = [start_time] {
+        return std::chrono::duration<double>(Clock::now() - start_time).count();
+    };
+    const auto report = [&statistics, progress] {
+        if (progress != nullptr) {
+            const double mebibytes = statistics.bytes / double(1 << 20);
+            *progress << "Loaded "s << mebibytes << " MiB, "s << statistics.documents << " documents, "s
+                      << mebibytes / std::max(statistics.seconds, 1e-9) << " MiB/s"s << std::endl;
+        }
+    };
+
+    // Stage 3: indexing stays in the calling thread, SearchServer is not thread-safe for writes
+    try {
+        size_t next_report = CORPUS_PROGRESS_STEP;
+        while (auto tokenized_chunk = tokenized_chunks.Pop()) {
+            for (const TokenizedDocument& document : tokenized_chunk->documents) {
+                search_server.AddTokenizedDocument(document.id, document.normalized.words, document.status, document.ratings);
+            }
+            statistics.bytes += tokenized_chunk->data.size();
+            statistics.documents += tokenized_chunk->documents.size();
+            if (statistics.bytes >= next_report) {
+                statistics.seconds = elapsed_seconds();
+                report();
+                next_report += CORPUS_PROGRESS_STEP;
+            }
+        }
+    } catch (...) {
+        close_queues();
+        reader.wait();
+        tokenizer.wait();
+        throw;
+    }
+    reader.get();
+    tokenizer.get();
+
+    statistics.seconds = elapsed_seconds();
+    report();
+    return statistics;
+}
+
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, const std::string& path, std::ostream* progress) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::invalid_argument("Cannot open corpus "s + path);
+    }
+    return LoadCorpus(search_server, input, progress);
+}
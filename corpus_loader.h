@@ -0,0 +1,22 @@
+#pragma once
+#include "search_server.h"
+
+#include <iostream>
+#include <string>
+
+const size_t CORPUS_CHUNK_SIZE = 4 << 20;
+const size_t CORPUS_QUEUE_CAPACITY = 8;
+const size_t CORPUS_PROGRESS_STEP = 64 << 20;
+
+struct CorpusLoadStatistics {
+    size_t bytes = 0;
+    size_t documents = 0;
+    double seconds = 0.0;
+};
+
+// Loads a TSV corpus, one document per line: "id<TAB>status<TAB>ratings<TAB>text", where
+// status is ACTUAL, IRRELEVANT, BANNED or REMOVED and ratings are separated by spaces.
+// The input is read in large chunks, records are parsed in place and reading, tokenizing
+// and indexing run concurrently. Progress and throughput go to progress if it is given
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, std::istream& input, std::ostream* progress = nullptr);
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, const std::string& path, std::ostream* progress = nullptr);
@@ -0,0 +1,143 @@
+#include "document_attributes.h"
+
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+DocumentFilter& DocumentFilter::WithStatus(DocumentStatus status) {
+    return Where(STATUS_ATTRIBUTE, status);
+}
+
+DocumentFilter& DocumentFilter::WithStatuses(const std::vector<DocumentStatus>& statuses) {
+    std::vector<int> values;
+    for (DocumentStatus status : statuses) {
+        values.push_back(static_cast<int>(status));
+    }
+    return WhereIn(STATUS_ATTRIBUTE, values);
+}
+
+DocumentFilter& DocumentFilter::WithRatingBetween(int min_rating, int max_rating) {
+    return WhereBetween(RATING_ATTRIBUTE, min_rating, max_rating);
+}
+
+DocumentFilter& DocumentFilter::Where(std::string_view attribute, int value) {
+    return WhereIn(attribute, {value});
+}
+
+DocumentFilter& DocumentFilter::WhereIn(std::string_view attribute, const std::vector<int>& values) {
+    clauses_.push_back({std::string(attribute), values, std::nullopt});
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::WhereBetween(std::string_view attribute, int min_value, int max_value) {
+    if (min_value > max_value) {
+        throw std::invalid_argument("Empty range for attribute "s + std::string(attribute));
+    }
+    clauses_.push_back({std::string(attribute), {}, std::pair{min_value, max_value}});
+    return *this;
+}
+
+void DocumentAttributes::Set(int document_id, std::string_view attribute, int value) {
+    auto column_it = columns_.find(attribute);
+    if (column_it == columns_.end()) {
+        column_it = columns_.emplace(std::string(attribute), Column{}).first;
+    }
+    Column& column = column_it->second;
+
+    const auto [value_it, inserted] = column.document_to_value.emplace(document_id, value);
+    if (!inserted) {
+        if (value_it->second == value) {
+            return;
+        }
+        const auto old_documents_it = column.value_to_documents.find(value_it->second);
+        old_documents_it->second.Remove(document_id);
+        if (old_documents_it->second.Empty()) {
+            column.value_to_documents.erase(old_documents_it);
+        }
+        value_it->second = value;
+    }
+    column.value_to_documents[value].Add(document_id);
+    all_documents_.Add(document_id);
+}
+
+std::optional<int> DocumentAttributes::Get(int document_id, std::string_view attribute) const {
+    const auto column_it = columns_.find(attribute);
+    if (column_it == columns_.end()) {
+        return std::nullopt;
+    }
+    const auto value_it = column_it->second.document_to_value.find(document_id);
+    if (value_it == column_it->second.document_to_value.end()) {
+        return std::nullopt;
+    }
+    return value_it->second;
+}
+
+void DocumentAttributes::RemoveDocument(int document_id) {
+    for (auto& [_, column] : columns_) {
+        const auto value_it = column.document_to_value.find(document_id);
+        if (value_it == column.document_to_value.end()) {
+            continue;
+        }
+        const auto documents_it = column.value_to_documents.find(value_it->second);
+        documents_it->second.Remove(document_id);
+        if (documents_it->second.Empty()) {
+            column.value_to_documents.erase(documents_it);
+        }
+        column.document_to_value.erase(value_it);
+    }
+    all_documents_.Remove(document_id);
+}
+
+DocumentBitmap DocumentAttributes::Select(const DocumentFilter& filter) const {
+    DocumentBitmap result = all_documents_;
+    for (const DocumentFilter::Clause& clause : filter.clauses_) {
+        DocumentBitmap clause_documents;
+        const auto column_it = columns_.find(clause.attribute);
+        if (column_it != columns_.end()) {
+            const auto& value_to_documents = column_it->second.value_to_documents;
+            if (clause.range) {
+                const auto begin = value_to_documents.lower_bound(clause.range->first);
+                const auto end = value_to_documents.upper_bound(clause.range->second);
+                for (auto it = begin; it != end; ++it) {
+                    clause_documents |= it->second;
+                }
+            }
+            for (int value : clause.values) {
+                const auto documents_it = value_to_documents.find(value);
+                if (documents_it != value_to_documents.end()) {
+                    clause_documents |= documents_it->second;
+                }
+            }
+        }
+        result &= clause_documents;
+        if (result.Empty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+const DocumentBitmap& DocumentAttributes::GetDocuments(std::string_view attribute, int value) const {
+    static const DocumentBitmap no_documents;
+    const auto column_it = columns_.find(attribute);
+    if (column_it == columns_.end()) {
+        return no_documents;
+    }
+    const auto documents_it = column_it->second.value_to_documents.find(value);
+    return documents_it == column_it->second.value_to_documents.end() ? no_documents : documents_it->second;
+}
+
+std::map<int, size_t> DocumentAttributes::CountFacet(std::string_view attribute, const DocumentBitmap& documents) const {
+    std::map<int, size_t> counts;
+    const auto column_it = columns_.find(attribute);
+    if (column_it == columns_.end()) {
+        return counts;
+    }
+    for (const auto& [value, value_documents] : column_it->second.value_to_documents) {
+        const size_t count = value_documents.CountIntersection(documents);
+        if (count > 0) {
+            counts[value] = count;
+        }
+    }
+    return counts;
+}
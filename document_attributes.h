@@ -0,0 +1,63 @@
+#pragma once
+#include "document.h"
+#include "document_bitmap.h"
+
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+const std::string STATUS_ATTRIBUTE = "status";
+const std::string RATING_ATTRIBUTE = "rating";
+
+// Declarative document filter: a conjunction of clauses, each clause accepts
+// documents whose attribute takes one of the listed values or lies in a range
+class DocumentFilter {
+public:
+    DocumentFilter& WithStatus(DocumentStatus status);
+    DocumentFilter& WithStatuses(const std::vector<DocumentStatus>& statuses);
+    DocumentFilter& WithRatingBetween(int min_rating, int max_rating);
+
+    DocumentFilter& Where(std::string_view attribute, int value);
+    DocumentFilter& WhereIn(std::string_view attribute, const std::vector<int>& values);
+    DocumentFilter& WhereBetween(std::string_view attribute, int min_value, int max_value);
+
+    template <typename Enum, typename = std::enable_if_t<std::is_enum_v<Enum>>>
+    DocumentFilter& Where(std::string_view attribute, Enum value) {
+        return Where(attribute, static_cast<int>(value));
+    }
+
+private:
+    friend class DocumentAttributes;
+
+    struct Clause {
+        std::string attribute;
+        std::vector<int> values;
+        std::optional<std::pair<int, int>> range;
+    };
+    std::vector<Clause> clauses_;
+};
+
+// Column store of integer document attributes with a bitmap of documents per value
+class DocumentAttributes {
+public:
+    void Set(int document_id, std::string_view attribute, int value);
+    std::optional<int> Get(int document_id, std::string_view attribute) const;
+    void RemoveDocument(int document_id);
+
+    DocumentBitmap Select(const DocumentFilter& filter) const;
+    // Documents whose attribute equals value, without copying the bitmap
+    const DocumentBitmap& GetDocuments(std::string_view attribute, int value) const;
+    // Number of documents per attribute value among the given documents
+    std::map<int, size_t> CountFacet(std::string_view attribute, const DocumentBitmap& documents) const;
+
+private:
+    struct Column {
+        std::map<int, int> document_to_value;
+        std::map<int, DocumentBitmap> value_to_documents;
+    };
+    std::map<std::string, Column, std::less<>> columns_;
+    DocumentBitmap all_documents_;
+};
@@ -0,0 +1,267 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+int CountTrailingZeros(uint64_t word) {
+    // De Bruijn sequence lookup of the isolated lowest bit
+    static const int positions[64] = {
+        0, 1, 2, 53, 3, 7, 54, 27, 4, 38, 41, 8, 34, 55, 48, 28,
+        62, 5, 39, 46, 44, 42, 22, 9, 24, 35, 59, 56, 49, 18, 29, 11,
+        63, 52, 6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+        51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12,
+    };
+    return positions[((word & (~word + 1)) * 0x022FDD63CC95386DULL) >> 58];
+}
+
+static size_t CountBits(uint64_t word) {
+    size_t count = 0;
+    for (; word != 0; word &= word - 1) {
+        ++count;
+    }
+    return count;
+}
+
+bool DocumentBitmap::Container::IsBitset() const {
+    return !bits.empty();
+}
+
+bool DocumentBitmap::Container::Contains(uint16_t value) const {
+    if (IsBitset()) {
+        return (bits[value >> 6] >> (value & 63)) & 1;
+    }
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+void DocumentBitmap::Container::ConvertToBitset() {
+    bits.assign(BITSET_WORD_COUNT, 0);
+    for (uint16_t value : values) {
+        bits[value >> 6] |= uint64_t{1} << (value & 63);
+    }
+    values.clear();
+    values.shrink_to_fit();
+}
+
+void DocumentBitmap::Container::ConvertToArray() {
+    values.clear();
+    values.reserve(size);
+    for (size_t word_index = 0; word_index < BITSET_WORD_COUNT; ++word_index) {
+        for (uint64_t word = bits[word_index]; word != 0; word &= word - 1) {
+            values.push_back(static_cast<uint16_t>(word_index * 64 + CountTrailingZeros(word)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+void DocumentBitmap::Add(int document_id) {
+    const uint32_t id = static_cast<uint32_t>(document_id);
+    const uint16_t key = static_cast<uint16_t>(id >> 16);
+    const uint16_t value = static_cast<uint16_t>(id & 0xFFFF);
+
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    const size_t index = key_it - keys_.begin();
+    if (key_it == keys_.end() || *key_it != key) {
+        keys_.insert(key_it, key);
+        containers_.insert(containers_.begin() + index, Container{});
+    }
+
+    Container& container = containers_[index];
+    if (container.IsBitset()) {
+        uint64_t& word = container.bits[value >> 6];
+        const uint64_t mask = uint64_t{1} << (value & 63);
+        if ((word & mask) == 0) {
+            word |= mask;
+            ++container.size;
+        }
+        return;
+    }
+    const auto value_it = std::lower_bound(container.values.begin(), container.values.end(), value);
+    if (value_it != container.values.end() && *value_it == value) {
+        return;
+    }
+    container.values.insert(value_it, value);
+    if (++container.size > MAX_ARRAY_SIZE) {
+        container.ConvertToBitset();
+    }
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    const uint32_t id = static_cast<uint32_t>(document_id);
+    const uint16_t key = static_cast<uint16_t>(id >> 16);
+    const uint16_t value = static_cast<uint16_t>(id & 0xFFFF);
+
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (key_it == keys_.end() || *key_it != key) {
+        return;
+    }
+    const size_t index = key_it - keys_.begin();
+    Container& container = containers_[index];
+    if (container.IsBitset()) {
+        uint64_t& word = container.bits[value >> 6];
+        const uint64_t mask = uint64_t{1} << (value & 63);
+        if ((word & mask) == 0) {
+            return;
+        }
+        word &= ~mask;
+        // Convert back only well below the threshold so that Add/Remove do not flip-flop
+        if (--container.size < MAX_ARRAY_SIZE / 2) {
+            container.ConvertToArray();
+        }
+    } else {
+        const auto value_it = std::lower_bound(container.values.begin(), container.values.end(), value);
+        if (value_it == container.values.end() || *value_it != value) {
+            return;
+        }
+        container.values.erase(value_it);
+        --container.size;
+    }
+
+    if (container.size == 0) {
+        keys_.erase(key_it);
+        containers_.erase(containers_.begin() + index);
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    const uint32_t id = static_cast<uint32_t>(document_id);
+    const Container* container = FindContainer(static_cast<uint16_t>(id >> 16));
+    return container != nullptr && container->Contains(static_cast<uint16_t>(id & 0xFFFF));
+}
+
+size_t DocumentBitmap::Size() const {
+    size_t size = 0;
+    for (const Container& container : containers_) {
+        size += container.size;
+    }
+    return size;
+}
+
+bool DocumentBitmap::Empty() const {
+    return keys_.empty();
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        const Container* other_container = other.FindContainer(keys_[i]);
+        if (other_container == nullptr) {
+            continue;
+        }
+        Container container = Intersect(containers_[i], *other_container);
+        if (container.size > 0) {
+            keys.push_back(keys_[i]);
+            containers.push_back(std::move(container));
+        }
+    }
+    keys_ = std::move(keys);
+    containers_ = std::move(containers);
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < keys_.size() || j < other.keys_.size()) {
+        if (j == other.keys_.size() || (i < keys_.size() && keys_[i] < other.keys_[j])) {
+            keys.push_back(keys_[i]);
+            containers.push_back(std::move(containers_[i++]));
+        } else if (i == keys_.size() || other.keys_[j] < keys_[i]) {
+            keys.push_back(other.keys_[j]);
+            containers.push_back(other.containers_[j++]);
+        } else {
+            keys.push_back(keys_[i]);
+            containers.push_back(Unite(containers_[i++], other.containers_[j++]));
+        }
+    }
+    keys_ = std::move(keys);
+    containers_ = std::move(containers);
+    return *this;
+}
+
+size_t DocumentBitmap::CountIntersection(const DocumentBitmap& other) const {
+    size_t count = 0;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        const Container* other_container = other.FindContainer(keys_[i]);
+        if (other_container != nullptr) {
+            count += Intersect(containers_[i], *other_container).size;
+        }
+    }
+    return count;
+}
+
+const DocumentBitmap::Container* DocumentBitmap::FindContainer(uint16_t key) const {
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (key_it == keys_.end() || *key_it != key) {
+        return nullptr;
+    }
+    return &containers_[key_it - keys_.begin()];
+}
+
+DocumentBitmap::Container DocumentBitmap::Intersect(const Container& lhs, const Container& rhs) {
+    Container result;
+    if (lhs.IsBitset() && rhs.IsBitset()) {
+        result.bits.resize(BITSET_WORD_COUNT);
+        for (size_t word_index = 0; word_index < BITSET_WORD_COUNT; ++word_index) {
+            result.bits[word_index] = lhs.bits[word_index] & rhs.bits[word_index];
+            result.size += CountBits(result.bits[word_index]);
+        }
+        if (result.size <= MAX_ARRAY_SIZE) {
+            result.ConvertToArray();
+        }
+        return result;
+    }
+    if (!lhs.IsBitset() && !rhs.IsBitset()) {
+        std::set_intersection(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(),
+                              std::back_inserter(result.values));
+    } else {
+        const Container& array = lhs.IsBitset() ? rhs : lhs;
+        const Container& bitset = lhs.IsBitset() ? lhs : rhs;
+        std::copy_if(array.values.begin(), array.values.end(), std::back_inserter(result.values),
+                     [&bitset](uint16_t value) { return bitset.Contains(value); });
+    }
+    result.size = result.values.size();
+    return result;
+}
+
+DocumentBitmap::Container DocumentBitmap::Unite(const Container& lhs, const Container& rhs) {
+    Container result;
+    if (!lhs.IsBitset() && !rhs.IsBitset()) {
+        std::set_union(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(),
+                       std::back_inserter(result.values));
+        result.size = result.values.size();
+        if (result.size > MAX_ARRAY_SIZE) {
+            result.ConvertToBitset();
+        }
+        return result;
+    }
+    result = lhs.IsBitset() ? lhs : rhs;
+    const Container& other = lhs.IsBitset() ? rhs : lhs;
+    if (other.IsBitset()) {
+        for (size_t word_index = 0; word_index < BITSET_WORD_COUNT; ++word_index) {
+            result.bits[word_index] |= other.bits[word_index];
+        }
+    } else {
+        for (uint16_t value : other.values) {
+            result.bits[value >> 6] |= uint64_t{1} << (value & 63);
+        }
+    }
+    result.size = 0;
+    for (uint64_t word : result.bits) {
+        result.size += CountBits(word);
+    }
+    return result;
+}
+
+DocumentBitmap operator&(DocumentBitmap lhs, const DocumentBitmap& rhs) {
+    lhs &= rhs;
+    return lhs;
+}
+
+DocumentBitmap operator|(DocumentBitmap lhs, const DocumentBitmap& rhs) {
+    lhs |= rhs;
+    return lhs;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index of the lowest set bit, word must not be zero
+int CountTrailingZeros(uint64_t word);
+
+// Compressed set of document ids in the spirit of roaring bitmaps: ids are grouped
+// by their high 16 bits, each group keeps its low 16 bits either as a sorted array
+// (while sparse) or as a 65536-bit bitset (once dense)
+class DocumentBitmap {
+public:
+    void Add(int document_id);
+    void Remove(int document_id);
+    bool Contains(int document_id) const;
+
+    size_t Size() const;
+    bool Empty() const;
+
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+    size_t CountIntersection(const DocumentBitmap& other) const;
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    static const size_t MAX_ARRAY_SIZE = 4096;
+    static const size_t BITSET_WORD_COUNT = 1024;
+
+    struct Container {
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> bits;
+        size_t size = 0;
+
+        bool IsBitset() const;
+        bool Contains(uint16_t value) const;
+        void ConvertToBitset();
+        void ConvertToArray();
+    };
+
+    std::vector<uint16_t> keys_;
+    std::vector<Container> containers_;
+
+    const Container* FindContainer(uint16_t key) const;
+    static Container Intersect(const Container& lhs, const Container& rhs);
+    static Container Unite(const Container& lhs, const Container& rhs);
+};
+
+DocumentBitmap operator&(DocumentBitmap lhs, const DocumentBitmap& rhs);
+DocumentBitmap operator|(DocumentBitmap lhs, const DocumentBitmap& rhs);
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const {
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        const int high = static_cast<int>(keys_[i]) << 16;
+        const Container& container = containers_[i];
+        if (!container.IsBitset()) {
+            for (uint16_t value : container.values) {
+                function(high | value);
+            }
+            continue;
+        }
+        for (size_t word_index = 0; word_index < BITSET_WORD_COUNT; ++word_index) {
+            for (uint64_t word = container.bits[word_index]; word != 0; word &= word - 1) {
+                function(high | static_cast<int>(word_index * 64 + CountTrailingZeros(word)));
+            }
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#include "fuzzy_term_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_set>
+
+// Byte length of the UTF-8 character starting at pos, terms are already validated by NormalizeText
+static size_t GetCharacterLength(std::string_view word, size_t pos) {
+    size_t length = 1;
+    while (pos + length < word.size() && (static_cast<uint8_t>(word[pos + length]) & 0xC0) == 0x80) {
+        ++length;
+    }
+    return length;
+}
+
+static std::u32string DecodeCharacters(std::string_view word) {
+    std::u32string characters;
+    characters.reserve(word.size());
+    for (size_t pos = 0; pos < word.size();) {
+        const size_t length = GetCharacterLength(word, pos);
+        char32_t code_point = static_cast<uint8_t>(word[pos]) & (length == 1 ? 0x7F : 0xFF >> (length + 1));
+        for (size_t i = 1; i < length; ++i) {
+            code_point = (code_point << 6) | (static_cast<uint8_t>(word[pos + i]) & 0x3F);
+        }
+        characters.push_back(code_point);
+        pos += length;
+    }
+    return characters;
+}
+
+FuzzyTermIndex::FuzzyTermIndex(int max_distance)
+    : max_distance_(max_distance) {
+}
+
+void FuzzyTermIndex::AddTerm(std::string_view term) {
+    const auto term_index = static_cast<uint32_t>(terms_.size());
+    terms_.emplace_back(term);
+    for (std::string& variant : GenerateDeletes(term, max_distance_)) {
+        deletes_[std::move(variant)].push_back(term_index);
+    }
+}
+
+std::vector<std::pair<std::string_view, int>> FuzzyTermIndex::FindTerms(std::string_view word, int max_distance) const {
+    max_distance = std::min(max_distance, max_distance_);
+    std::unordered_set<uint32_t> candidates;
+    for (const std::string& variant : GenerateDeletes(word, max_distance)) {
+        const auto it = deletes_.find(variant);
+        if (it != deletes_.end()) {
+            candidates.insert(it->second.begin(), it->second.end());
+        }
+    }
+
+    std::vector<std::pair<std::string_view, int>> result;
+    for (uint32_t term_index : candidates) {
+        const std::string_view term = terms_[term_index];
+        const int distance = ComputeEditDistance(word, term, max_distance);
+        if (distance <= max_distance) {
+            result.push_back({term, distance});
+        }
+    }
+    return result;
+}
+
+int FuzzyTermIndex::GetMaxDistance() const {
+    return max_distance_;
+}
+
+std::vector<std::string> FuzzyTermIndex::GenerateDeletes(std::string_view word, int max_distance) const {
+    std::vector<std::string> variants = {std::string(word)};
+    size_t level_begin = 0;
+    for (int distance = 1; distance <= max_distance; ++distance) {
+        const size_t level_end = variants.size();
+        for (size_t i = level_begin; i < level_end; ++i) {
+            const std::string parent = variants[i];
+            std::string_view previous_character;
+            for (size_t pos = 0; pos < parent.size();) {
+                const size_t length = GetCharacterLength(parent, pos);
+                const std::string_view character = std::string_view(parent).substr(pos, length);
+                // Deleting any character of a run of equal characters gives the same variant
+                if (character != previous_character) {
+                    variants.push_back(parent.substr(0, pos) + parent.substr(pos + length));
+                }
+                previous_character = character;
+                pos += length;
+            }
+        }
+        level_begin = level_end;
+    }
+    std::sort(variants.begin(), variants.end());
+    variants.erase(std::unique(variants.begin(), variants.end()), variants.end());
+    return variants;
+}
+
+int ComputeEditDistance(std::string_view lhs_word, std::string_view rhs_word, int max_distance) {
+    const std::u32string lhs = DecodeCharacters(lhs_word);
+    const std::u32string rhs = DecodeCharacters(rhs_word);
+    const int lhs_size = static_cast<int>(lhs.size());
+    const int rhs_size = static_cast<int>(rhs.size());
+    if (std::abs(lhs_size - rhs_size) > max_distance) {
+        return max_distance + 1;
+    }
+
+    // Three rolling rows of the dynamic programming table are enough for transpositions
+    std::vector<int> before_previous(rhs_size + 1);
+    std::vector<int> previous(rhs_size + 1);
+    std::vector<int> current(rhs_size + 1);
+    for (int j = 0; j <= rhs_size; ++j) {
+        previous[j] = j;
+    }
+    for (int i = 1; i <= lhs_size; ++i) {
+        current[0] = i;
+        int row_min = current[0];
+        for (int j = 1; j <= rhs_size; ++j) {
+            const int cost = lhs[i - 1] == rhs[j - 1] ? 0 : 1;
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = std::min(row_min, current[j]);
+        }
+        if (row_min > max_distance) {
+            return max_distance + 1;
+        }
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[rhs_size], max_distance + 1);
+}
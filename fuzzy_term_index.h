@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Deletion-neighbourhood (SymSpell) index over dictionary terms. Every term is
+// stored under all its variants with up to max_distance characters deleted, so
+// the terms within max_distance edits of a word share at least one variant with it.
+class FuzzyTermIndex {
+public:
+    explicit FuzzyTermIndex(int max_distance);
+
+    // The index keeps its own copy of the term, so copies of the index stay valid
+    void AddTerm(std::string_view term);
+
+    // Terms within max_distance edits of word (max_distance <= GetMaxDistance()),
+    // paired with their edit distance. Distance is counted in UTF-8 characters
+    std::vector<std::pair<std::string_view, int>> FindTerms(std::string_view word, int max_distance) const;
+
+    int GetMaxDistance() const;
+
+private:
+    int max_distance_;
+    // A deque never moves its elements, the views returned by FindTerms stay valid
+    std::deque<std::string> terms_;
+    std::unordered_map<std::string, std::vector<uint32_t>> deletes_;
+
+    std::vector<std::string> GenerateDeletes(std::string_view word, int max_distance) const;
+};
+
+// Optimal string alignment distance (Levenshtein with adjacent transpositions),
+// over UTF-8 characters, returns max_distance + 1 once the distance is known to exceed max_distance
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
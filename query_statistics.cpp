@@ -0,0 +1,142 @@
+#include "query_statistics.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+QueryStatistics::QueryStatistics(Clock::duration bucket_duration, size_t bucket_count)
+    : bucket_duration_(bucket_duration), buckets_(bucket_count) {
+}
+
+void QueryStatistics::AddRequest(std::string_view query, size_t result_count, Clock::duration latency) {
+    Bucket& bucket = AcquireBucket(GetEpoch(Clock::now()));
+    bucket.requests.fetch_add(1, std::memory_order_relaxed);
+    if (result_count == 0) {
+        bucket.no_result_requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    bucket.latency_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count(), std::memory_order_relaxed);
+
+    const uint64_t estimate = AddToSketch(query);
+    // Lock-free fast path: most queries are not frequent enough to enter the top
+    if (estimate > min_heavy_hitter_count_.load(std::memory_order_relaxed)) {
+        UpdateHeavyHitters(query, estimate);
+    }
+}
+
+int QueryStatistics::GetNoResultRequests() const {
+    return static_cast<int>(ComputeWindowTotals().no_result_requests);
+}
+
+uint64_t QueryStatistics::GetRequestCount() const {
+    return ComputeWindowTotals().requests;
+}
+
+double QueryStatistics::GetRequestsPerSecond() const {
+    using namespace std::chrono;
+    const Clock::duration window = bucket_duration_ * buckets_.size();
+    const Clock::duration covered = std::min(window, Clock::now() - start_time_);
+    return ComputeWindowTotals().requests / std::max(duration<double>(covered).count(), 1e-9);
+}
+
+QueryStatistics::Clock::duration QueryStatistics::GetAverageLatency() const {
+    const WindowTotals totals = ComputeWindowTotals();
+    if (totals.requests == 0) {
+        return Clock::duration::zero();
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(totals.latency_ns / totals.requests));
+}
+
+std::vector<std::pair<std::string, uint64_t>> QueryStatistics::GetHeavyHitters() const {
+    std::vector<std::pair<std::string, uint64_t>> heavy_hitters;
+    {
+        std::lock_guard<std::mutex> guard(heavy_hitters_mutex_);
+        heavy_hitters = heavy_hitters_;
+    }
+    std::sort(heavy_hitters.begin(), heavy_hitters.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second > rhs.second;
+    });
+    return heavy_hitters;
+}
+
+int64_t QueryStatistics::GetEpoch(Clock::time_point time) const {
+    // Epochs start from 1, so that the zero epoch of a fresh bucket never matches
+    return (time - start_time_) / bucket_duration_ + 1;
+}
+
+QueryStatistics::Bucket& QueryStatistics::AcquireBucket(int64_t epoch) {
+    Bucket& bucket = buckets_[epoch % buckets_.size()];
+    while (true) {
+        int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+        // A newer epoch means this thread was delayed by a whole window, count it in anyway
+        if (bucket_epoch >= epoch) {
+            return bucket;
+        }
+        // The bucket holds an expired epoch: one thread resets it while the others wait
+        if (bucket_epoch != RESETTING_EPOCH
+            && bucket.epoch.compare_exchange_strong(bucket_epoch, RESETTING_EPOCH, std::memory_order_acquire)) {
+            bucket.requests.store(0, std::memory_order_relaxed);
+            bucket.no_result_requests.store(0, std::memory_order_relaxed);
+            bucket.latency_ns.store(0, std::memory_order_relaxed);
+            bucket.epoch.store(epoch, std::memory_order_release);
+            return bucket;
+        }
+        std::this_thread::yield();
+    }
+}
+
+QueryStatistics::WindowTotals QueryStatistics::ComputeWindowTotals() const {
+    const int64_t current_epoch = GetEpoch(Clock::now());
+    const int64_t first_epoch = current_epoch - static_cast<int64_t>(buckets_.size()) + 1;
+    WindowTotals totals;
+    for (const Bucket& bucket : buckets_) {
+        const int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+        if (bucket_epoch >= first_epoch && bucket_epoch <= current_epoch && bucket_epoch > 0) {
+            totals.requests += bucket.requests.load(std::memory_order_relaxed);
+            totals.no_result_requests += bucket.no_result_requests.load(std::memory_order_relaxed);
+            totals.latency_ns += bucket.latency_ns.load(std::memory_order_relaxed);
+        }
+    }
+    return totals;
+}
+
+uint64_t QueryStatistics::AddToSketch(std::string_view query) {
+    const uint64_t hash = std::hash<std::string_view>{}(query);
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        // splitmix64 finalizer gives an independent-looking hash per row
+        uint64_t row_hash = hash + (row + 1) * 0x9E3779B97F4A7C15ULL;
+        row_hash = (row_hash ^ (row_hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        row_hash = (row_hash ^ (row_hash >> 27)) * 0x94D049BB133111EBULL;
+        row_hash ^= row_hash >> 31;
+        const uint64_t count = sketch_[row][row_hash % SKETCH_WIDTH].fetch_add(1, std::memory_order_relaxed) + 1;
+        estimate = std::min(estimate, count);
+    }
+    return estimate;
+}
+
+void QueryStatistics::UpdateHeavyHitters(std::string_view query, uint64_t estimate) {
+    std::lock_guard<std::mutex> guard(heavy_hitters_mutex_);
+    const auto it = std::find_if(heavy_hitters_.begin(), heavy_hitters_.end(), [query](const auto& heavy_hitter) {
+        return heavy_hitter.first == query;
+    });
+    if (it != heavy_hitters_.end()) {
+        it->second = std::max(it->second, estimate);
+    } else if (heavy_hitters_.size() < HEAVY_HITTER_COUNT) {
+        heavy_hitters_.emplace_back(std::string(query), estimate);
+    } else {
+        const auto min_it = std::min_element(heavy_hitters_.begin(), heavy_hitters_.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second < rhs.second;
+        });
+        if (min_it->second >= estimate) {
+            return;
+        }
+        *min_it = {std::string(query), estimate};
+    }
+
+    if (heavy_hitters_.size() == HEAVY_HITTER_COUNT) {
+        const auto min_it = std::min_element(heavy_hitters_.begin(), heavy_hitters_.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second < rhs.second;
+        });
+        min_heavy_hitter_count_.store(min_it->second, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+const size_t HEAVY_HITTER_COUNT = 10;
+const size_t SKETCH_DEPTH = 4;
+const size_t SKETCH_WIDTH = 4096;
+
+// Query statistics over a sliding time window, safe to update from many threads at once.
+// The window is split into bucket_count buckets of bucket_duration each, so every counter
+// is a fixed-size sum regardless of the request rate. Requests are not stored
+class QueryStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStatistics(Clock::duration bucket_duration = std::chrono::minutes(1), size_t bucket_count = 1440);
+
+    void AddRequest(std::string_view query, size_t result_count, Clock::duration latency);
+
+    int GetNoResultRequests() const;
+    uint64_t GetRequestCount() const;
+    double GetRequestsPerSecond() const;
+    Clock::duration GetAverageLatency() const;
+
+    // Most frequent queries since construction with their count-min sketch estimates,
+    // in descending order of the estimate
+    std::vector<std::pair<std::string, uint64_t>> GetHeavyHitters() const;
+
+private:
+    static constexpr int64_t RESETTING_EPOCH = -1;
+
+    struct Bucket {
+        std::atomic<int64_t> epoch{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+        std::atomic<uint64_t> latency_ns{0};
+    };
+
+    struct WindowTotals {
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+        uint64_t latency_ns = 0;
+    };
+
+    const Clock::time_point start_time_ = Clock::now();
+    const Clock::duration bucket_duration_;
+    std::vector<Bucket> buckets_;
+
+    std::array<std::array<std::atomic<uint32_t>, SKETCH_WIDTH>, SKETCH_DEPTH> sketch_{};
+    std::atomic<uint64_t> min_heavy_hitter_count_{0};
+    mutable std::mutex heavy_hitters_mutex_;
+    std::vector<std::pair<std::string, uint64_t>> heavy_hitters_;
+
+    int64_t GetEpoch(Clock::time_point time) const;
+    Bucket& AcquireBucket(int64_t epoch);
+    WindowTotals ComputeWindowTotals() const;
+    uint64_t AddToSketch(std::string_view query);
+    void UpdateHeavyHitters(std::string_view query, uint64_t estimate);
+};
@@ -0,0 +1,65 @@
+#include "remove_duplicates.h"
+
+double EstimateSimilarity(const MinHashSignature& lhs, const MinHashSignature& rhs) {
+    size_t equal_count = 0;
+    for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i) {
+        if (lhs[i] == rhs[i]) {
+            ++equal_count;
+        }
+    }
+    return static_cast<double>(equal_count) / MINHASH_SIGNATURE_SIZE;
+}
+
+DuplicateDetector::DuplicateDetector(double min_similarity)
+    : min_similarity_(min_similarity) {
+}
+
+std::optional<int> DuplicateDetector::FindDuplicate(const MinHashSignature& signature) const {
+    std::optional<int> duplicate_id;
+    for (size_t band = 0; band < LSH_BAND_COUNT; ++band) {
+        const auto candidates_it = bands_[band].find(ComputeBandKey(signature, band));
+        if (candidates_it == bands_[band].end()) {
+            continue;
+        }
+        for (int candidate_id : candidates_it->second) {
+            if ((!duplicate_id || candidate_id < *duplicate_id)
+                && EstimateSimilarity(signature, signatures_.at(candidate_id)) >= min_similarity_) {
+                duplicate_id = candidate_id;
+            }
+        }
+    }
+    return duplicate_id;
+}
+
+void DuplicateDetector::Add(int document_id, const MinHashSignature& signature) {
+    signatures_[document_id] = signature;
+    for (size_t band = 0; band < LSH_BAND_COUNT; ++band) {
+        bands_[band][ComputeBandKey(signature, band)].push_back(document_id);
+    }
+}
+
+uint64_t DuplicateDetector::ComputeBandKey(const MinHashSignature& signature, size_t band) {
+    const size_t rows = MINHASH_SIGNATURE_SIZE / LSH_BAND_COUNT;
+    uint64_t key = 0;
+    for (size_t row = band * rows; row < (band + 1) * rows; ++row) {
+        key = (key ^ signature[row]) * 0x100000001B3ULL;
+    }
+    return key;
+}
+
+bool AddDocumentUnlessDuplicate(SearchServer& search_server, DuplicateDetector& detector, int document_id,
+                                std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const NormalizedText normalized = search_server.TokenizeDocument(document);
+    // Repeated words do not change the minimums, so the word list serves as the term set
+    const MinHashSignature signature = ComputeMinHashSignature(normalized.words);
+    if (detector.FindDuplicate(signature)) {
+        return false;
+    }
+    search_server.AddTokenizedDocument(document_id, normalized.words, status, ratings);
+    detector.Add(document_id, signature);
+    return true;
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity) {
+    return RemoveDuplicates(std::execution::seq, search_server, min_similarity);
+}
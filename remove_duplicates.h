@@ -0,0 +1,104 @@
+#pragma once
+#include "search_server.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const size_t MINHASH_SIGNATURE_SIZE = 64;
+const size_t LSH_BAND_COUNT = 16;
+const double NEAR_DUPLICATE_SIMILARITY = 0.8;
+
+// MinHash of a document term set: the share of equal components of two signatures
+// estimates the Jaccard similarity of the sets, equal sets give equal signatures
+using MinHashSignature = std::array<uint64_t, MINHASH_SIGNATURE_SIZE>;
+
+template <typename TermContainer>
+MinHashSignature ComputeMinHashSignature(const TermContainer& terms);
+
+double EstimateSimilarity(const MinHashSignature& lhs, const MinHashSignature& rhs);
+
+// Finds documents similar to the already added ones with LSH banding: signatures are cut
+// into LSH_BAND_COUNT bands and only documents sharing a whole band are compared
+class DuplicateDetector {
+public:
+    explicit DuplicateDetector(double min_similarity = NEAR_DUPLICATE_SIMILARITY);
+
+    // An added document with the same terms or estimated similarity of at least min_similarity
+    std::optional<int> FindDuplicate(const MinHashSignature& signature) const;
+    void Add(int document_id, const MinHashSignature& signature);
+
+private:
+    double min_similarity_;
+    std::unordered_map<int, MinHashSignature> signatures_;
+    std::array<std::unordered_map<uint64_t, std::vector<int>>, LSH_BAND_COUNT> bands_;
+
+    static uint64_t ComputeBandKey(const MinHashSignature& signature, size_t band);
+};
+
+// Adds the document unless the detector already knows a duplicate of it, returns whether it was added
+bool AddDocumentUnlessDuplicate(SearchServer& search_server, DuplicateDetector& detector, int document_id,
+                                std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+// Removes exact and near duplicates keeping the document with the least id of each group,
+// returns the removed ids. Signatures are computed in parallel under a parallel policy
+template <class ExecutionPolicy>
+std::vector<int> RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server,
+                                  double min_similarity = NEAR_DUPLICATE_SIMILARITY);
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity = NEAR_DUPLICATE_SIMILARITY);
+
+// The index-th of MINHASH_SIGNATURE_SIZE hash functions, derived from the string hash of a term.
+// Double hashing gives all of them from a single string hash, the splitmix64 finalizer breaks
+// the linear dependency between them
+inline uint64_t DeriveTermHash(uint64_t term_hash, size_t index) {
+    uint64_t value = term_hash + index * ((term_hash >> 32) | 1) + index * 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+template <typename TermContainer>
+MinHashSignature ComputeMinHashSignature(const TermContainer& terms) {
+    MinHashSignature signature;
+    signature.fill(UINT64_MAX);
+    for (const auto& term : terms) {
+        const uint64_t term_hash = std::hash<std::string_view>{}(term);
+        for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i) {
+            signature[i] = std::min(signature[i], DeriveTermHash(term_hash, i));
+        }
+    }
+    return signature;
+}
+
+template <class ExecutionPolicy>
+std::vector<int> RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server, double min_similarity) {
+    std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::sort(document_ids.begin(), document_ids.end());
+
+    std::vector<MinHashSignature> signatures(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), signatures.begin(), [&search_server](int document_id) {
+        std::vector<std::string_view> terms;
+        for (const auto& [term, _] : search_server.GetWordFrequencies(document_id)) {
+            terms.push_back(term);
+        }
+        return ComputeMinHashSignature(terms);
+    });
+
+    DuplicateDetector detector(min_similarity);
+    std::vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (detector.FindDuplicate(signatures[i])) {
+            duplicate_ids.push_back(document_ids[i]);
+        } else {
+            detector.Add(document_ids[i], signatures[i]);
+        }
+    }
+    search_server.RemoveDocuments(policy, duplicate_ids);
+    return duplicate_ids;
+}
@@ -1,28 +1,26 @@
 #include "request_queue.h"
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {           
+    const Clock::time_point start_time = Clock::now();
     std::vector<Document> result = search_server_.FindTopDocuments(std::execution::par, raw_query,status);
-    AddRequest(raw_query,result);
+    AddRequest(raw_query, result, Clock::now() - start_time);
     return result;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {       
+    const Clock::time_point start_time = Clock::now();
     std::vector<Document> result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(raw_query,result);
+    AddRequest(raw_query, result, Clock::now() - start_time);
     return result;
 }
 
 int RequestQueue::GetNoResultRequests() const {        
-    int no_results = 0;
-    for(const QueryResult& request: requests_){
-        if(request.result.empty()){
-            ++no_results;
-        }
-    }
-    return no_results;
+    return statistics_.GetNoResultRequests();
+}
+
+void RequestQueue::AddRequest(std::string_view raw_query, const std::vector<Document>& result, Clock::duration latency){
+    statistics_.AddRequest(raw_query, result.size(), latency);
+}
+
+const QueryStatistics& RequestQueue::GetStatistics() const {
+    return statistics_;
 }
-void RequestQueue::AddRequest(const std::string& raw_query,const std::vector<Document>& result){
-    if(requests_.size() == sec_in_day_){
-        requests_.pop_front();
-    }
-    requests_.push_back({raw_query,result});
-}
\ No newline at end of file
@@ -1,34 +1,31 @@
 #pragma once
+#include "query_statistics.h"
 #include "search_server.h"
-#include <deque>
 
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server):search_server_(search_server) {
-        
+    using Clock = QueryStatistics::Clock;
+
+    // По умолчанию статистика собирается за последние сутки (1440 минут)
+    explicit RequestQueue(const SearchServer& search_server, Clock::duration bucket_duration = std::chrono::minutes(1), size_t bucket_count = 1440)
+        : search_server_(search_server), statistics_(bucket_duration, bucket_count) {
     }
-    // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
+    // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики.
+    // Методы можно вызывать одновременно из нескольких потоков
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        
-        if(requests_.size() == sec_in_day_){
-            requests_.pop_front();
-        }
+        const Clock::time_point start_time = Clock::now();
         std::vector<Document> result = search_server_.FindTopDocuments(raw_query,document_predicate);
-        requests_.push_back({raw_query,result});
+        AddRequest(raw_query, result, Clock::now() - start_time);
         return result;
     }
 
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
     int GetNoResultRequests() const;
-    void AddRequest(const std::string& raw_query,const std::vector<Document>& result);
+    void AddRequest(std::string_view raw_query, const std::vector<Document>& result, Clock::duration latency);
+    const QueryStatistics& GetStatistics() const;
 private:
-    struct QueryResult {
-        const std::string query;
-        std::vector<Document> result;
-    };
-    std::deque<QueryResult> requests_;
-    const static int sec_in_day_ = 1440;
     const SearchServer& search_server_;
-};
\ No newline at end of file
+    QueryStatistics statistics_;
+};
@@ -0,0 +1,24 @@
+#include "search_context.h"
+
+SearchContext::SearchContext(Clock::time_point deadline)
+    : deadline_(deadline) {
+}
+
+void SearchContext::Cancel() {
+    cancelled_.store(true, std::memory_order_relaxed);
+}
+
+bool SearchContext::CheckStop() {
+    if (interrupted_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if (cancelled_.load(std::memory_order_relaxed) || Clock::now() >= deadline_) {
+        interrupted_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool SearchContext::WasInterrupted() const {
+    return interrupted_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+// Number of postings the search loops visit between two stop checks
+const size_t SEARCH_CHECK_INTERVAL = 1024;
+
+// Cooperative stop condition of one query: a deadline and a cancellation flag.
+// The search checks it while walking the postings and, once stopped, ranks what it
+// has scored so far. Safe to share between the searching threads and the caller
+class SearchContext {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SearchContext() = default;
+    explicit SearchContext(Clock::time_point deadline);
+
+    void Cancel();
+    // True once the deadline has passed or the query was cancelled
+    bool CheckStop();
+    // True if a search observed the stop, so its results are partial
+    bool WasInterrupted() const;
+
+private:
+    const Clock::time_point deadline_ = Clock::time_point::max();
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> interrupted_{false};
+};
@@ -1,52 +1,208 @@
 #include "search_server.h"
+#include <cctype>
 #include <cmath>
 
-SearchServer::SearchServer(const std::string &stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text)) { // Invoke delegating constructor from string container
+bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+SearchServer::SearchServer(const std::string &stop_words_text, Stemming stemming)
+    : SearchServer(SplitIntoWords(stop_words_text), stemming) { // Invoke delegating constructor from string container
 
 }
-SearchServer::SearchServer(std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text)) { // Invoke delegating constructor from string container
+
+SearchServer::SearchServer(std::string_view stop_words_text, Stemming stemming)
+    : SearchServer(SplitIntoWords(stop_words_text), stemming) { // Invoke delegating constructor from string container
 
 }
 
+SearchServer::SearchServer(const SearchServer& other)
+    : stemming_(other.stemming_)
+    , stop_words_(other.stop_words_)
+    , word_to_document_freqs_(other.word_to_document_freqs_)
+    , terms_by_id_(other.terms_by_id_.size())
+    , forward_index_mode_(other.forward_index_mode_)
+    , forward_pool_(other.forward_pool_)
+    , forward_garbage_size_(other.forward_garbage_size_)
+    , documents_(other.documents_)
+    , document_ids_(other.document_ids_)
+    , max_prefix_expansion_count_(other.max_prefix_expansion_count_)
+    , fuzzy_term_index_(other.fuzzy_term_index_)
+    , document_attributes_(other.document_attributes_) {
+    for (auto& term : word_to_document_freqs_) {
+        terms_by_id_[term.second.term_id] = &term;
+    }
+}
+
 void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(std::execution::seq,document_id);
 }
 
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
     return FindTopDocuments(std::execution::seq, raw_query, status);
 }
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, int min_rating) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, min_rating);
+}
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const{
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter);
+}
+
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(std::string_view raw_query, const DocumentFilter& filter,
+                                                             const std::vector<std::string>& facet_attributes) const {
+    return FindTopDocumentsWithFacets(std::execution::seq, raw_query, filter, facet_attributes);
+}
+
+SearchPage SearchServer::FindTopDocumentsPage(std::string_view raw_query, const std::optional<PageToken>& after, size_t page_size) const {
+    return FindTopDocumentsPage(std::execution::seq, raw_query, DocumentStatus::ACTUAL, after, page_size);
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     return MatchDocument(std::execution::seq, raw_query,document_id);
 }
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
                                const std::vector<int> &ratings) {
+    AddTokenizedDocument(document_id, SplitIntoWordsNoStop(document).words, status, ratings);
+}
+
+NormalizedText SearchServer::TokenizeDocument(std::string_view document) const {
+    return SplitIntoWordsNoStop(document);
+}
+
+void SearchServer::AddTokenizedDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status,
+                                        const std::vector<int> &ratings) {
     if ((document_id < 0) || (documents_.count(document_id) > 0)){
         throw std::invalid_argument("Invalid document_id"s);
     }
     
-    const auto words = SplitIntoWordsNoStop(document);
     size_t document_size =  words.size();
     const double inv_word_count = 1.0 /document_size;
+    std::vector<ForwardEntry> forward_entries;
+    forward_entries.reserve(document_size);
     for (std::string_view word_view : words) {
-        std::string word{word_view.data(), word_view.size()};
-        word_to_document_freqs_[std::string(word)][document_id] += inv_word_count;
-        document_to_word_[document_id][word_to_document_freqs_.find(word)->first] += 1.0/document_size;
+        auto word_it = word_to_document_freqs_.find(word_view);
+        const bool is_new_word = word_it == word_to_document_freqs_.end();
+        if (is_new_word) {
+            const int term_id = static_cast<int>(terms_by_id_.size());
+            word_it = word_to_document_freqs_.emplace(std::string(word_view), TermData{term_id, {}}).first;
+            terms_by_id_.push_back(&*word_it);
+        }
+        word_it->second.document_freqs[document_id] += inv_word_count;
+        forward_entries.push_back({word_it->second.term_id, inv_word_count});
+        if (is_new_word && fuzzy_term_index_) {
+            fuzzy_term_index_->AddTerm(word_it->first);
+        }
+    }
+
+    DocumentData document_data{ComputeAverageRating(ratings), status};
+    if (forward_index_mode_ == ForwardIndexMode::STORED) {
+        // Repeated words are merged into one entry per term
+        std::sort(forward_entries.begin(), forward_entries.end(), [](const ForwardEntry& lhs, const ForwardEntry& rhs) {
+            return lhs.term_id < rhs.term_id;
+        });
+        document_data.forward_offset = forward_pool_.size();
+        for (const ForwardEntry& entry : forward_entries) {
+            if (forward_pool_.size() > document_data.forward_offset && forward_pool_.back().term_id == entry.term_id) {
+                forward_pool_.back().term_freq += entry.term_freq;
+            } else {
+                forward_pool_.push_back(entry);
+            }
+        }
+        document_data.forward_size = forward_pool_.size() - document_data.forward_offset;
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    const int rating = document_data.rating;
+    documents_.emplace(document_id, document_data);
+    document_attributes_.Set(document_id, STATUS_ATTRIBUTE, static_cast<int>(status));
+    document_attributes_.Set(document_id, RATING_ATTRIBUTE, rating);
+    rating_selections_.AddDocument(document_id, status, rating);
     document_ids_.push_back(document_id);
 }
 
+SearchServer::RatingSelectionCache::RatingSelectionCache(const RatingSelectionCache&) {
+}
+
+SearchServer::RatingSelectionCache::RatingSelectionCache(RatingSelectionCache&&) noexcept {
+}
+
+std::shared_ptr<const DocumentBitmap> SearchServer::RatingSelectionCache::Select(const DocumentAttributes& attributes, DocumentStatus status,
+                                                                                int min_rating) {
+    const std::pair key{status, min_rating};
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        const auto it = selections_.find(key);
+        if (it != selections_.end()) {
+            return it->second;
+        }
+    }
+    // Concurrent queries select without holding the lock, the first one to finish is kept
+    auto selection = std::make_shared<DocumentBitmap>(
+        attributes.Select(DocumentFilter().WithStatus(status).WithRatingBetween(min_rating, std::numeric_limits<int>::max())));
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (selections_.size() >= MAX_CACHED_RATING_SELECTIONS && selections_.count(key) == 0) {
+        selections_.clear();
+    }
+    return selections_.emplace(key, std::move(selection)).first->second;
+}
+
+void SearchServer::RatingSelectionCache::AddDocument(int document_id, DocumentStatus status, int rating) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& [key, selection] : selections_) {
+        if (key.first == status && rating >= key.second) {
+            selection->Add(document_id);
+        }
+    }
+}
+
+void SearchServer::RatingSelectionCache::RemoveDocument(int document_id) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& [key, selection] : selections_) {
+        selection->Remove(document_id);
+    }
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+void SearchServer::SetDocumentAttribute(int document_id, std::string_view attribute, int value) {
+    if (documents_.count(document_id) == 0){
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    if (attribute == STATUS_ATTRIBUTE || attribute == RATING_ATTRIBUTE){
+        throw std::invalid_argument("Attribute "s + std::string(attribute) + " is set by AddDocument"s);
+    }
+    document_attributes_.Set(document_id, attribute, value);
+}
+
+void SearchServer::SetMaxPrefixExpansionCount(size_t count) {
+    max_prefix_expansion_count_ = count;
+}
+
+void SearchServer::EnableTypoTolerance(int max_distance) {
+    if (max_distance < 1){
+        throw std::invalid_argument("Typo distance must be positive"s);
+    }
+    fuzzy_term_index_.emplace(max_distance);
+    for (const auto& [word, _] : word_to_document_freqs_){
+        fuzzy_term_index_->AddTerm(word);
+    }
+}
+
 std::vector<int>::iterator SearchServer::begin() {
     return document_ids_.begin();
 }
@@ -66,18 +222,32 @@ bool SearchServer::IsValidWord(const std::string_view &word) {
                    });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view &text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view &word : SplitIntoWords(text)){
-        if (!IsValidWord(word)){
-            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
+std::set<std::string, std::less<>> SearchServer::NormalizeStopWords(const std::set<std::string, std::less<>>& stop_words) {
+    if (!all_of(stop_words.begin(), stop_words.end(), IsValidWord)) {
+        throw std::invalid_argument("Some of stop words are invalid"s);
+    }
+    std::set<std::string, std::less<>> normalized_stop_words;
+    for (const std::string& stop_word : stop_words) {
+        for (std::string_view word : NormalizeText(stop_word).words) {
+            normalized_stop_words.emplace(word);
         }
+    }
+    return normalized_stop_words;
+}
 
-        if (!IsStopWord(word)){
-            words.push_back(word);
-        }
+std::string_view SearchServer::StemIfEnabled(std::string_view word) const {
+    return stemming_ == Stemming::LIGHT ? StemWord(word) : word;
+}
+
+NormalizedText SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
+    NormalizedText normalized = NormalizeText(text);
+    std::vector<std::string_view>& words = normalized.words;
+    // Stop words are matched before stemming
+    words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) { return IsStopWord(word); }), words.end());
+    for (std::string_view& word : words) {
+        word = StemIfEnabled(word);
     }
-    return words;
+    return normalized;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int> &ratings) {
@@ -100,44 +270,302 @@ SearchServer::QueryWordView SearchServer::ParseQueryWord(std::string_view &text)
         is_minus = true;
         word = word.substr(1);
     }
+    int typo_distance = 0;
+    if (word.size() > 1 && word.back() == '~'){
+        typo_distance = fuzzy_term_index_ ? fuzzy_term_index_->GetMaxDistance() : MAX_TYPO_DISTANCE;
+        word.remove_suffix(1);
+    }
+    else if (word.size() > 2 && word[word.size() - 2] == '~' && std::isdigit(static_cast<unsigned char>(word.back()))){
+        typo_distance = word.back() - '0';
+        word.remove_suffix(2);
+        if (typo_distance == 0){
+            throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
+        }
+    }
+    if (typo_distance > 0 && (!fuzzy_term_index_ || typo_distance > fuzzy_term_index_->GetMaxDistance())){
+        throw std::invalid_argument("Typo distance of query word "s + std::string(text) + " is not enabled"s);
+    }
+    bool is_prefix = false;
+    if (typo_distance == 0 && !word.empty() && word.back() == '*'){
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
 
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)){
+    if (word.empty() || word[0] == '-' || word.back() == '*' || !IsValidWord(word)){
         throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
 
-    return {word, is_minus, IsStopWord(word)};
+    return {word, is_minus, is_prefix, typo_distance};
 }
 
 // Existence required
 double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.size());
+    return ComputeInverseDocumentFreq(word_to_document_freqs_.find(word)->second.document_freqs.size());
+}
+
+double SearchServer::ComputeInverseDocumentFreq(size_t document_freq) const {
+    return log(GetDocumentCount() * 1.0 / document_freq);
+}
+
+std::pair<std::map<std::string, SearchServer::TermData, std::less<>>::const_iterator, std::map<std::string, SearchServer::TermData, std::less<>>::const_iterator>
+SearchServer::GetPrefixRange(std::string_view prefix) const {
+    // The range ends at the smallest string greater than every string with the prefix
+    std::string prefix_end(prefix);
+    while (!prefix_end.empty() && static_cast<unsigned char>(prefix_end.back()) == 0xFF) {
+        prefix_end.pop_back();
+    }
+    if (prefix_end.empty()) {
+        return { word_to_document_freqs_.lower_bound(prefix), word_to_document_freqs_.end() };
+    }
+    ++prefix_end.back();
+    return { word_to_document_freqs_.lower_bound(prefix), word_to_document_freqs_.lower_bound(prefix_end) };
+}
+
+std::vector<const std::pair<const std::string, SearchServer::TermData>*> SearchServer::ExpandPrefix(std::string_view prefix, SearchContext* context) const {
+    std::vector<const std::pair<const std::string, TermData>*> expansions;
+    size_t visited_terms = 0;
+    const auto [first, last] = GetPrefixRange(prefix);
+    for (auto it = first; it != last; ++it) {
+        if (context != nullptr && visited_terms++ % SEARCH_CHECK_INTERVAL == 0 && context->CheckStop()) {
+            break;
+        }
+        if (!it->second.document_freqs.empty()) {
+            expansions.push_back(&*it);
+        }
+    }
+    if (expansions.size() > max_prefix_expansion_count_) {
+        std::nth_element(expansions.begin(), expansions.begin() + max_prefix_expansion_count_, expansions.end(),
+                         [](const std::pair<const std::string, TermData>* lhs, const std::pair<const std::string, TermData>* rhs) {
+                             return lhs->second.document_freqs.size() > rhs->second.document_freqs.size();
+                         });
+        expansions.resize(max_prefix_expansion_count_);
+    }
+    return expansions;
+}
+
+SearchServer::WordFrequenciesView SearchServer::GetWordFrequencies(int document_id) const {
+    WordFrequenciesView view;
+    view.search_server_ = this;
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return view;
+    }
+    if (forward_index_mode_ == ForwardIndexMode::STORED) {
+        view.begin_ = forward_pool_.data() + document_it->second.forward_offset;
+        view.end_ = view.begin_ + document_it->second.forward_size;
+    } else {
+        view.reconstructed_ = std::make_shared<const std::vector<ForwardEntry>>(ReconstructForwardEntries(document_id));
+        view.begin_ = view.reconstructed_->data();
+        view.end_ = view.begin_ + view.reconstructed_->size();
+    }
+    return view;
+}
+
+void SearchServer::SetForwardIndexMode(ForwardIndexMode mode) {
+    if (mode == forward_index_mode_) {
+        return;
+    }
+    forward_index_mode_ = mode;
+    forward_pool_.clear();
+    forward_pool_.shrink_to_fit();
+    forward_garbage_size_ = 0;
+    if (mode == ForwardIndexMode::RECONSTRUCTED) {
+        for (auto& [_, document_data] : documents_) {
+            document_data.forward_offset = 0;
+            document_data.forward_size = 0;
+        }
+        return;
+    }
+
+    // One pass over the postings in term id order gives every document its sorted entries
+    std::map<int, std::vector<ForwardEntry>> document_entries;
+    for (size_t term_id = 0; term_id < terms_by_id_.size(); ++term_id) {
+        for (const auto [document_id, term_freq] : terms_by_id_[term_id]->second.document_freqs) {
+            document_entries[document_id].push_back({static_cast<int>(term_id), term_freq});
+        }
+    }
+    for (auto& [document_id, document_data] : documents_) {
+        const std::vector<ForwardEntry>& entries = document_entries[document_id];
+        document_data.forward_offset = forward_pool_.size();
+        document_data.forward_size = entries.size();
+        forward_pool_.insert(forward_pool_.end(), entries.begin(), entries.end());
+    }
+}
+
+std::vector<SearchServer::ForwardEntry> SearchServer::ReconstructForwardEntries(int document_id) const {
+    std::vector<ForwardEntry> entries;
+    for (size_t term_id = 0; term_id < terms_by_id_.size(); ++term_id) {
+        const auto& document_freqs = terms_by_id_[term_id]->second.document_freqs;
+        const auto it = document_freqs.find(document_id);
+        if (it != document_freqs.end()) {
+            entries.push_back({static_cast<int>(term_id), it->second});
+        }
+    }
+    return entries;
+}
+
+void SearchServer::EraseDocuments(std::map<int, double>& document_freqs, const std::vector<int>& document_ids) {
+    if (document_ids.size() < document_freqs.size()) {
+        for (int document_id : document_ids) {
+            document_freqs.erase(document_id);
+        }
+        return;
+    }
+    // Few postings left compared to the batch: walk the list instead of searching it
+    for (auto it = document_freqs.begin(); it != document_freqs.end();) {
+        if (std::binary_search(document_ids.begin(), document_ids.end(), it->first)) {
+            it = document_freqs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SearchServer::CompactForwardIndex() {
+    std::vector<ForwardEntry> forward_pool;
+    forward_pool.reserve(forward_pool_.size() - forward_garbage_size_);
+    for (auto& [_, document_data] : documents_) {
+        const auto begin = forward_pool_.begin() + document_data.forward_offset;
+        document_data.forward_offset = forward_pool.size();
+        forward_pool.insert(forward_pool.end(), begin, begin + document_data.forward_size);
+    }
+    forward_pool_ = std::move(forward_pool);
+    forward_garbage_size_ = 0;
+}
+
+SearchServer::WordFrequenciesView::Iterator::Iterator(const SearchServer* search_server, const ForwardEntry* entry)
+    : search_server_(search_server), entry_(entry) {
 }
 
-std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
-    std::map<std::string_view, double> map = {};
-    if(std::count(document_ids_.begin(),document_ids_.end(),document_id) == 0) {
-        return map;
+SearchServer::WordFrequenciesView::Iterator::value_type SearchServer::WordFrequenciesView::Iterator::operator*() const {
+    return {search_server_->terms_by_id_[entry_->term_id]->first, entry_->term_freq};
+}
+
+SearchServer::WordFrequenciesView::Iterator& SearchServer::WordFrequenciesView::Iterator::operator++() {
+    ++entry_;
+    return *this;
+}
+
+SearchServer::WordFrequenciesView::Iterator SearchServer::WordFrequenciesView::Iterator::operator++(int) {
+    Iterator old = *this;
+    ++entry_;
+    return old;
+}
+
+bool SearchServer::WordFrequenciesView::Iterator::operator==(const Iterator& other) const {
+    return entry_ == other.entry_;
+}
+
+bool SearchServer::WordFrequenciesView::Iterator::operator!=(const Iterator& other) const {
+    return entry_ != other.entry_;
+}
+
+SearchServer::WordFrequenciesView::Iterator SearchServer::WordFrequenciesView::begin() const {
+    return {search_server_, begin_};
+}
+
+SearchServer::WordFrequenciesView::Iterator SearchServer::WordFrequenciesView::end() const {
+    return {search_server_, end_};
+}
+
+size_t SearchServer::WordFrequenciesView::size() const {
+    return end_ - begin_;
+}
+
+bool SearchServer::WordFrequenciesView::empty() const {
+    return begin_ == end_;
+}
+
+size_t SearchServer::WordFrequenciesView::count(std::string_view word) const {
+    const auto word_it = search_server_->word_to_document_freqs_.find(word);
+    if (word_it == search_server_->word_to_document_freqs_.end()) {
+        return 0;
     }
-    return document_to_word_.at(document_id);
+    const int term_id = word_it->second.term_id;
+    return std::binary_search(begin_, end_, ForwardEntry{term_id, 0.0}, [](const ForwardEntry& lhs, const ForwardEntry& rhs) {
+        return lhs.term_id < rhs.term_id;
+    }) ? 1 : 0;
 }
 
 void AddDocument(SearchServer& search_server,int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings) {
     search_server.AddDocument(document_id, document, status, ratings);
 }
 
+std::vector<std::pair<std::string_view, int>> SearchServer::ExpandTypos(std::string_view word, int max_distance, SearchContext* context) const {
+    std::vector<std::pair<std::string_view, int>> expansions;
+    if (context != nullptr && context->CheckStop()) {
+        return expansions;
+    }
+    for (const auto& [term, distance] : fuzzy_term_index_->FindTerms(word, max_distance)) {
+        const auto word_it = word_to_document_freqs_.find(term);
+        if (!word_it->second.document_freqs.empty()) {
+            expansions.push_back({word_it->first, distance});
+        }
+    }
+    return expansions;
+}
+
+ExecutionPlan SearchServer::PlanQueryExecution(const QueryView& query) const {
+    size_t cost = 0;
+    const auto add_postings = [this, &cost](std::string_view word) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end()) {
+            cost += word_it->second.document_freqs.size();
+        }
+    };
+    for (std::string_view word : query.plus_words) {
+        add_postings(word);
+    }
+    // The same posting lists FindAllDocuments will merge: the most frequent terms with the prefix
+    for (std::string_view prefix : query.plus_prefixes) {
+        for (const auto* term : ExpandPrefix(prefix)) {
+            cost += term->second.document_freqs.size();
+        }
+    }
+    for (const auto& [word, _] : query.plus_typo_words) {
+        add_postings(word);
+    }
+    return PlanExecution(cost, query.plus_words.size() + query.plus_prefixes.size() + query.plus_typo_words.size());
+}
+
 SearchServer::QueryView SearchServer::ParseQuery(std::string_view text) const {
     QueryView result;
     std::vector<std::string_view> splited_words = SplitIntoWords(text);
-    for(std::string_view word: splited_words){
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop){
-            if (query_word.is_minus){
-                result.minus_words.insert(query_word.data);
+    for(std::string_view raw_word: splited_words){
+        const auto query_word = ParseQueryWord(raw_word);
+        NormalizedText normalized = NormalizeText(query_word.data);
+        for (size_t i = 0; i < normalized.words.size(); ++i) {
+            std::string_view word = normalized.words[i];
+            // Punctuation splits a query word into several, only the last one keeps the "*"
+            const bool is_prefix = query_word.is_prefix && i + 1 == normalized.words.size();
+            if (!is_prefix){
+                if (IsStopWord(word)){
+                    continue;
+                }
+                word = StemIfEnabled(word);
+            }
+            if (query_word.typo_distance > 0){
+                auto& typo_words = query_word.is_minus ? result.minus_typo_words : result.plus_typo_words;
+                typo_words[word] = std::max(typo_words[word], query_word.typo_distance);
+            }
+            else if (is_prefix){
+                if (query_word.is_minus){
+                    result.minus_prefixes.insert(word);
+                }
+                else{
+                    result.plus_prefixes.insert(word);
+                }
+            }
+            else if (query_word.is_minus){
+                result.minus_words.insert(word);
             }
             else{
-                result.plus_words.insert(query_word.data);
+                result.plus_words.insert(word);
             }
         }
+        if (normalized.buffer){
+            result.normalized_words.push_back(std::move(normalized.buffer));
+        }
     }
 
     return result;
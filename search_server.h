@@ -1,11 +1,21 @@
 #pragma once
 
+#include "auto_execution.h"
 #include "document.h"
+#include "document_attributes.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "fuzzy_term_index.h"
+#include "search_context.h"
+#include "text_normalization.h"
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -13,36 +23,200 @@
 #include <vector>
 #include <execution>
 #include <atomic>
+#include <cmath>
 
 const double EPSILON = 1e-6;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const int NUM_BASKET = 12;
+// ConcurrentMap buckets per concurrent task under AUTO_EXECUTION
+const size_t BUCKETS_PER_TASK = 4;
+const size_t MAX_PREFIX_EXPANSION_COUNT = 64;
+const int MAX_TYPO_DISTANCE = 2;
+const double TYPO_MATCH_WEIGHT = 0.5;
+// Distinct (status, min_rating) selections kept between FindTopDocuments calls
+const size_t MAX_CACHED_RATING_SELECTIONS = 64;
+
+struct FacetedSearchResult {
+    std::vector<Document> documents;
+    // Attribute -> value -> number of matched documents, counted before truncation to the top
+    std::map<std::string, std::map<int, size_t>, std::less<>> facets;
+};
+
+// Ranking key of the last document of a page: the next page continues right after it
+struct PageToken {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Empty on the last page
+    std::optional<PageToken> next_page;
+};
+
+// Top documents of a query that may have been stopped early: when is_partial is set,
+// only the postings visited before the stop were scored
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+enum class ForwardIndexMode {
+    // Per-document word frequencies are kept in a shared pool: fast removal and matching
+    STORED,
+    // Nothing is kept per document, word frequencies are reconstructed from the postings
+    RECONSTRUCTED,
+};
+
+// Ranking order of search results: by relevance, then by rating, then by id
+bool IsRankedHigher(const Document& lhs, const Document& rhs);
+
 class SearchServer {
+private:
+    struct ForwardEntry {
+        int term_id;
+        double term_freq;
+    };
+
 public: 
+    // Word frequencies of one document. A view into the forward index: it is invalidated
+    // by adding or removing documents and by SetForwardIndexMode
+    class WordFrequenciesView {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<std::string_view, double>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            value_type operator*() const;
+            Iterator& operator++();
+            Iterator operator++(int);
+            bool operator==(const Iterator& other) const;
+            bool operator!=(const Iterator& other) const;
+
+        private:
+            friend class WordFrequenciesView;
+            Iterator(const SearchServer* search_server, const ForwardEntry* entry);
+
+            const SearchServer* search_server_;
+            const ForwardEntry* entry_;
+        };
+
+        Iterator begin() const;
+        Iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        size_t count(std::string_view word) const;
+
+    private:
+        friend class SearchServer;
+
+        const SearchServer* search_server_ = nullptr;
+        const ForwardEntry* begin_ = nullptr;
+        const ForwardEntry* end_ = nullptr;
+        // Owns the entries when the forward index is not stored
+        std::shared_ptr<const std::vector<ForwardEntry>> reconstructed_;
+    };
+
+    // Documents, queries and stop words are normalized alike: split on spaces and punctuation
+    // and case-folded, with light stemming the words are also reduced to their stems
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text);
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words, Stemming stemming = Stemming::NONE);
+    explicit SearchServer(const std::string& stop_words_text, Stemming stemming = Stemming::NONE);
+    explicit SearchServer(std::string_view stop_words_text, Stemming stemming = Stemming::NONE);
+    // The term index points at dictionary nodes, a copy rebuilds it over its own dictionary
+    SearchServer(const SearchServer& other);
+    SearchServer(SearchServer&& other) = default;
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Splits a document into the words AddDocument would index. Does not modify the server,
+    // so it may run concurrently with AddTokenizedDocument (e.g. in a loading pipeline).
+    // The words may point into document, which must outlive the result
+    NormalizedText TokenizeDocument(std::string_view document) const;
+    void AddTokenizedDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, const std::vector<int>& ratings);
     
+    // Methods taking an execution policy also accept AUTO_EXECUTION, which chooses between
+    // seq and par by the number of postings the call visits
     void RemoveDocument(int document_id);
     template< class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+    // Bulk removal: deletions are grouped by word and every affected posting list is
+    // rewritten once, posting lists are processed concurrently under a parallel policy
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    template <class ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&& policy, std::vector<int> document_ids);
     
     template <class ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
+    // Documents with the given status and a rating of at least min_rating
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, int min_rating) const;
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, int min_rating) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
+
+    template <class ExecutionPolicy>
+    FacetedSearchResult FindTopDocumentsWithFacets(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                                   const std::vector<std::string>& facet_attributes) const;
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query, const DocumentFilter& filter,
+                                                   const std::vector<std::string>& facet_attributes) const;
+
+    // Results [offset, offset + limit) of the ranking. Only the first offset + limit
+    // documents are ordered, the rest of the matches are never sorted
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t offset, size_t limit) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t offset, size_t limit) const;
+
+    // Cursor-based paging: pass the next_page token of the previous page (or nothing
+    // for the first page). A page costs one pass over the matches plus ordering page_size of them.
+    // Throws invalid_argument if page_size is 0
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                    const std::optional<PageToken>& after, size_t page_size) const;
+    template <class ExecutionPolicy>
+    SearchPage FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                    const std::optional<PageToken>& after, size_t page_size) const;
+    SearchPage FindTopDocumentsPage(std::string_view raw_query, const std::optional<PageToken>& after, size_t page_size) const;
+
+    // Stops scoring once the context deadline passes or it is cancelled and ranks the
+    // documents scored so far, prefix and typo expansions of plus words stop as well.
+    // Minus words are still applied in full. One context per query
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    SearchResult FindTopDocumentsWithin(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                        SearchContext& context) const;
+    template <class ExecutionPolicy>
+    SearchResult FindTopDocumentsWithin(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                        SearchContext& context) const;
 
     int GetDocumentCount() const;
 
+    // Integer attributes for DocumentFilter and facets, "status" and "rating" are set by AddDocument
+    void SetDocumentAttribute(int document_id, std::string_view attribute, int value);
+    template <typename Enum, typename = std::enable_if_t<std::is_enum_v<Enum>>>
+    void SetDocumentAttribute(int document_id, std::string_view attribute, Enum value);
+
+    // Limits the number of dictionary terms a "prefix*" query word expands to
+    void SetMaxPrefixExpansionCount(size_t count);
+    // Builds the index for "word~" / "word~N" query words, which also match dictionary
+    // terms within N edits. Each edit multiplies the term relevance by TYPO_MATCH_WEIGHT
+    void EnableTypoTolerance(int max_distance = MAX_TYPO_DISTANCE);
+
     std::vector<int>::iterator begin();
     std::vector<int>::iterator end();
 
@@ -50,30 +224,80 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 
-    // std::map<std::string, double, std::less<>> GetWordFrequencies(int document_id) const;
-    // std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
-    std::map<std::string_view, double> GetWordFrequencies(int document_id) const; 
+    WordFrequenciesView GetWordFrequencies(int document_id) const;
+
+    // Dropping the forward index saves about as much memory as the postings take,
+    // at the cost of slow GetWordFrequencies, MatchDocument and RemoveDocument
+    void SetForwardIndexMode(ForwardIndexMode mode);
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
-
+        // Range of the document entries in forward_pool_, sorted by term id
+        size_t forward_offset = 0;
+        size_t forward_size = 0;
+    };
+    struct TermData {
+        int term_id;
+        std::map<int, double> document_freqs;
+    };
+    // Documents with a status and a rating of at least min_rating, built on the first query
+    // and then kept up to date by AddDocument and RemoveDocument. Copies start empty
+    class RatingSelectionCache {
+    public:
+        RatingSelectionCache() = default;
+        RatingSelectionCache(const RatingSelectionCache&);
+        RatingSelectionCache(RatingSelectionCache&&) noexcept;
+
+        std::shared_ptr<const DocumentBitmap> Select(const DocumentAttributes& attributes, DocumentStatus status, int min_rating);
+        void AddDocument(int document_id, DocumentStatus status, int rating);
+        void RemoveDocument(int document_id);
+
+    private:
+        std::mutex mutex_;
+        std::map<std::pair<DocumentStatus, int>, std::shared_ptr<DocumentBitmap>> selections_;
     };
+    const Stemming stemming_;
     const std::set<std::string,std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>,std::less<>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_;
+    std::map<std::string, TermData, std::less<>> word_to_document_freqs_;
+    std::vector<std::pair<const std::string, TermData>*> terms_by_id_;
+    ForwardIndexMode forward_index_mode_ = ForwardIndexMode::STORED;
+    std::vector<ForwardEntry> forward_pool_;
+    // Entries of removed documents still occupying forward_pool_
+    size_t forward_garbage_size_ = 0;
     std::map<int, DocumentData> documents_;
     std::vector<int> document_ids_;
+    size_t max_prefix_expansion_count_ = MAX_PREFIX_EXPANSION_COUNT;
+    std::optional<FuzzyTermIndex> fuzzy_term_index_;
+    DocumentAttributes document_attributes_;
+    mutable RatingSelectionCache rating_selections_;
 
     bool IsStopWord(const std::string_view& word) const;
     static bool IsValidWord(const std::string_view& word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view& text) const;
+    static std::set<std::string, std::less<>> NormalizeStopWords(const std::set<std::string, std::less<>>& stop_words);
+    std::string_view StemIfEnabled(std::string_view word) const;
+    NormalizedText SplitIntoWordsNoStop(std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
+    // Entries of a document collected from the postings, sorted by term id
+    std::vector<ForwardEntry> ReconstructForwardEntries(int document_id) const;
+    void CompactForwardIndex();
+    // Erases the sorted document_ids from one posting list
+    static void EraseDocuments(std::map<int, double>& document_freqs, const std::vector<int>& document_ids);
+    // document_ids are sorted, unique and present
+    template <class ExecutionPolicy>
+    void RemoveSortedDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
+
+    // Calls function(policy, bucket_count). AUTO_EXECUTION is replaced by seq or par as
+    // plan_execution() decides, more concurrent tasks get more ConcurrentMap buckets
+    template <class ExecutionPolicy, typename PlanFunction, typename Function>
+    static decltype(auto) RunWithPolicy(ExecutionPolicy&& policy, PlanFunction plan_execution, Function function);
 
+    // Query word with its operators stripped, data is not normalized yet
     struct QueryWordView {
         std::string_view data;
         bool is_minus;
-        bool is_stop;
+        bool is_prefix;
+        int typo_distance;
     };
 
     QueryWordView ParseQueryWord(std::string_view& text) const;
@@ -81,69 +305,357 @@ private:
     struct QueryView {
         std::set<std::string_view> plus_words;
         std::set<std::string_view> minus_words;
+        std::set<std::string_view> plus_prefixes;
+        std::set<std::string_view> minus_prefixes;
+        std::map<std::string_view, int> plus_typo_words;
+        std::map<std::string_view, int> minus_typo_words;
+        // Query words changed by normalization
+        std::vector<std::unique_ptr<char[]>> normalized_words;
     };
 
     QueryView ParseQuery(std::string_view text) const;
     // Existence required
     double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    double ComputeInverseDocumentFreq(size_t document_freq) const;
+    // All dictionary terms starting with prefix: the dictionary is sorted, so they form one contiguous range
+    std::pair<std::map<std::string, TermData, std::less<>>::const_iterator, std::map<std::string, TermData, std::less<>>::const_iterator>
+    GetPrefixRange(std::string_view prefix) const;
+    // The most frequent dictionary terms starting with prefix. With a context,
+    // the dictionary scan stops early once the context is stopped
+    std::vector<const std::pair<const std::string, TermData>*> ExpandPrefix(std::string_view prefix, SearchContext* context = nullptr) const;
+    // Dictionary terms within max_distance edits of word, paired with their distance.
+    // Nothing is expanded if the context is already stopped
+    std::vector<std::pair<std::string_view, int>> ExpandTypos(std::string_view word, int max_distance, SearchContext* context = nullptr) const;
     
-    template <class ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, QueryView& query, DocumentPredicate document_predicate) const;
+    // DocumentSelector is called as selector(document_id) for every posting hit.
+    // Every selector type gets its own instantiation of the scoring loop.
+    // Without a context the whole postings are scored
+    template <class ExecutionPolicy, typename DocumentSelector>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, QueryView& query, DocumentSelector document_selector,
+                                           SearchContext* context = nullptr, size_t bucket_count = NUM_BASKET) const;
+    // Cost of FindAllDocuments: postings of the plus words, of at most max_prefix_expansion_count_
+    // terms per prefix and of the typo words themselves
+    ExecutionPlan PlanQueryExecution(const QueryView& query) const;
+    template <class ExecutionPolicy, typename DocumentSelector>
+    std::vector<Document> FindTopDocumentsBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                                     size_t offset = 0, size_t limit = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy, typename DocumentSelector>
+    SearchPage FindTopDocumentsPageBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                              const std::optional<PageToken>& after, size_t page_size) const;
+    template <class ExecutionPolicy, typename DocumentSelector>
+    SearchResult FindTopDocumentsWithinBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                                  SearchContext& context) const;
+    // Looks up the status and rating of every hit and passes them to the predicate
+    template <typename DocumentPredicate>
+    auto MakeDocumentSelector(const DocumentPredicate& document_predicate) const;
+
+    // Accepts every document, used when no document is filtered out
+    struct AnyDocumentSelector {
+        bool operator()(int) const {
+            return true;
+        }
+    };
+    // Accepts the documents of a precomputed bitmap, no per-hit document lookup
+    struct BitmapSelector {
+        const DocumentBitmap& documents;
+        bool operator()(int document_id) const {
+            return documents.Contains(document_id);
+        }
+    };
+    // Calls search(selector) with the cheapest selector accepting exactly the documents of the bitmap
+    template <typename Search>
+    auto SearchInDocuments(const DocumentBitmap& documents, Search search) const;
+    // Keeps the documents [offset, offset + limit) of the ranking, in ranking order
+    template <class ExecutionPolicy>
+    static void KeepTopDocuments(ExecutionPolicy&& policy, std::vector<Document>& documents,
+                                 size_t offset = 0, size_t limit = MAX_RESULT_DOCUMENT_COUNT);
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)){  // Extract non-empty stop words
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-    	using namespace std;
-        throw std::invalid_argument("Some of stop words are invalid"s);
-    }
+SearchServer::SearchServer(const StringContainer& stop_words, Stemming stemming)
+    : stemming_(stemming)
+    , stop_words_(NormalizeStopWords(MakeUniqueNonEmptyStrings(stop_words))){  // Extract non-empty stop words
+    // The first AUTO_EXECUTION query should not pay for the micro-benchmark
+    CalibrateAutoExecution();
 }
 
 template< class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    std::map<std::string_view, double> word_freq = GetWordFrequencies(document_id);
-    std::vector<std::pair<std::string_view, double>> word_freq_vec(word_freq.begin(),word_freq.end());
-    for_each(policy, word_freq_vec.begin(), word_freq_vec.end(), [this, document_id](auto& pair) {      
-            word_to_document_freqs_.find(pair.first)->second.erase(document_id);
-    });
+    RemoveDocuments(policy, std::vector<int>{document_id});
+}
+
+template <class ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, std::vector<int> document_ids) {
+    std::sort(document_ids.begin(), document_ids.end());
+    document_ids.erase(std::unique(document_ids.begin(), document_ids.end()), document_ids.end());
+    document_ids.erase(std::remove_if(document_ids.begin(), document_ids.end(), [this](int document_id) {
+                           return documents_.count(document_id) == 0;
+                       }),
+                       document_ids.end());
+    if (document_ids.empty()) {
+        return;
+    }
+    RunWithPolicy(
+        policy,
+        [this, &document_ids] {
+            // Postings to erase, a batch also filters the whole id list
+            size_t cost = document_ids.size() > 1 ? document_ids_.size() : 0;
+            if (forward_index_mode_ == ForwardIndexMode::STORED) {
+                for (int document_id : document_ids) {
+                    cost += documents_.at(document_id).forward_size;
+                }
+                return PlanExecution(cost, cost);
+            }
+            cost += terms_by_id_.size() * document_ids.size();
+            return PlanExecution(cost, terms_by_id_.size());
+        },
+        [this, &document_ids](auto&& chosen_policy, size_t) {
+            RemoveSortedDocuments(chosen_policy, document_ids);
+        });
+}
 
-    auto remove_it = find(policy, document_ids_.begin(), document_ids_.end(), document_id);
-    if (remove_it != document_ids_.end()) {
-        document_ids_.erase(remove_it);
+template <class ExecutionPolicy>
+void SearchServer::RemoveSortedDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+    if (forward_index_mode_ == ForwardIndexMode::STORED) {
+        // (term id, document id) pairs of all removed documents, grouped by term
+        std::vector<std::pair<int, int>> term_documents;
+        for (int document_id : document_ids) {
+            const WordFrequenciesView word_freqs = GetWordFrequencies(document_id);
+            for (const ForwardEntry* entry = word_freqs.begin_; entry != word_freqs.end_; ++entry) {
+                term_documents.push_back({entry->term_id, document_id});
+            }
+        }
+        std::sort(policy, term_documents.begin(), term_documents.end());
+        std::vector<size_t> group_begins;
+        for (size_t i = 0; i < term_documents.size(); ++i) {
+            if (i == 0 || term_documents[i].first != term_documents[i - 1].first) {
+                group_begins.push_back(i);
+            }
+        }
+        // Every group refers to a different posting list, so they can be rewritten concurrently
+        std::for_each(policy, group_begins.begin(), group_begins.end(), [this, &term_documents](size_t group_begin) {
+            const int term_id = term_documents[group_begin].first;
+            std::vector<int> term_document_ids;
+            for (size_t i = group_begin; i < term_documents.size() && term_documents[i].first == term_id; ++i) {
+                term_document_ids.push_back(term_documents[i].second);
+            }
+            EraseDocuments(terms_by_id_[term_id]->second.document_freqs, term_document_ids);
+        });
+    } else {
+        std::for_each(policy, terms_by_id_.begin(), terms_by_id_.end(), [&document_ids](auto* term) {
+            EraseDocuments(term->second.document_freqs, document_ids);
+        });
     }
 
-    auto remove_doc_it = documents_.find(document_id);
-    if (remove_doc_it != documents_.end()) {
-        documents_.erase(remove_doc_it);
+    if (document_ids.size() == 1) {
+        document_ids_.erase(find(policy, document_ids_.begin(), document_ids_.end(), document_ids.front()));
+    } else {
+        document_ids_.erase(std::remove_if(policy, document_ids_.begin(), document_ids_.end(), [&document_ids](int document_id) {
+                                return std::binary_search(document_ids.begin(), document_ids.end(), document_id);
+                            }),
+                            document_ids_.end());
+    }
+    for (int document_id : document_ids) {
+        const auto document_it = documents_.find(document_id);
+        forward_garbage_size_ += document_it->second.forward_size;
+        documents_.erase(document_it);
+        document_attributes_.RemoveDocument(document_id);
+        rating_selections_.RemoveDocument(document_id);
+    }
+    // Compacting once half of the pool is garbage keeps removal amortized O(document size)
+    if (forward_garbage_size_ * 2 > forward_pool_.size()) {
+        CompactForwardIndex();
     }
 }
 
 template <class ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    auto query = ParseQuery(raw_query);   
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    return FindTopDocumentsBySelector(policy, raw_query, MakeDocumentSelector(document_predicate));
+}
 
-    sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t offset, size_t limit) const {
+    return FindTopDocumentsBySelector(policy, raw_query, MakeDocumentSelector(document_predicate), offset, limit);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                     size_t offset, size_t limit) const {
+    return SearchInDocuments(document_attributes_.GetDocuments(STATUS_ATTRIBUTE, static_cast<int>(status)), [&](auto document_selector) {
+        return FindTopDocumentsBySelector(policy, raw_query, document_selector, offset, limit);
+    });
+}
+
+template <class ExecutionPolicy, typename DocumentSelector>
+std::vector<Document> SearchServer::FindTopDocumentsBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                                               size_t offset, size_t limit) const {
+    auto query = ParseQuery(raw_query);
+    return RunWithPolicy(policy, [this, &query] { return PlanQueryExecution(query); }, [&](auto&& chosen_policy, size_t bucket_count) {
+        auto matched_documents = FindAllDocuments(chosen_policy, query, document_selector, nullptr, bucket_count);
+        KeepTopDocuments(chosen_policy, matched_documents, offset, limit);
+        return matched_documents;
+    });
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                              const std::optional<PageToken>& after, size_t page_size) const {
+    return FindTopDocumentsPageBySelector(policy, raw_query, MakeDocumentSelector(document_predicate), after, page_size);
+}
+
+template <class ExecutionPolicy, typename DocumentSelector>
+SearchPage SearchServer::FindTopDocumentsPageBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                                        const std::optional<PageToken>& after, size_t page_size) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    auto query = ParseQuery(raw_query);
+    return RunWithPolicy(policy, [this, &query] { return PlanQueryExecution(query); }, [&](auto&& chosen_policy, size_t bucket_count) {
+        SearchPage page;
+        page.documents = FindAllDocuments(chosen_policy, query, document_selector, nullptr, bucket_count);
+        if (after) {
+            const Document last{after->document_id, after->relevance, after->rating};
+            page.documents.erase(remove_if(chosen_policy, page.documents.begin(), page.documents.end(),
+                                           [&last](const Document& document) { return !IsRankedHigher(last, document); }),
+                                 page.documents.end());
+        }
+        const bool has_next_page = page.documents.size() > page_size;
+        KeepTopDocuments(chosen_policy, page.documents, 0, page_size);
+        if (has_next_page) {
+            const Document& last = page.documents.back();
+            page.next_page = PageToken{last.relevance, last.rating, last.id};
+        }
+        return page;
+    });
+}
+
+template <class ExecutionPolicy>
+SearchPage SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                              const std::optional<PageToken>& after, size_t page_size) const {
+    return SearchInDocuments(document_attributes_.GetDocuments(STATUS_ATTRIBUTE, static_cast<int>(status)), [&](auto document_selector) {
+        return FindTopDocumentsPageBySelector(policy, raw_query, document_selector, after, page_size);
+    });
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocumentsWithin(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                  SearchContext& context) const {
+    return FindTopDocumentsWithinBySelector(policy, raw_query, MakeDocumentSelector(document_predicate), context);
+}
+
+template <class ExecutionPolicy>
+SearchResult SearchServer::FindTopDocumentsWithin(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                  SearchContext& context) const {
+    return SearchInDocuments(document_attributes_.GetDocuments(STATUS_ATTRIBUTE, static_cast<int>(status)), [&](auto document_selector) {
+        return FindTopDocumentsWithinBySelector(policy, raw_query, document_selector, context);
+    });
+}
+
+template <class ExecutionPolicy, typename DocumentSelector>
+SearchResult SearchServer::FindTopDocumentsWithinBySelector(ExecutionPolicy&& policy, std::string_view raw_query, DocumentSelector document_selector,
+                                                            SearchContext& context) const {
+    auto query = ParseQuery(raw_query);
+    return RunWithPolicy(policy, [this, &query] { return PlanQueryExecution(query); }, [&](auto&& chosen_policy, size_t bucket_count) {
+        SearchResult result;
+        result.documents = FindAllDocuments(chosen_policy, query, document_selector, &context, bucket_count);
+        result.is_partial = context.WasInterrupted();
+        KeepTopDocuments(chosen_policy, result.documents);
+        return result;
+    });
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter) const {
+    const DocumentBitmap selected_documents = document_attributes_.Select(filter);
+    return SearchInDocuments(selected_documents, [&](auto document_selector) {
+        return FindTopDocumentsBySelector(policy, raw_query, document_selector);
+    });
+}
+
+template <class ExecutionPolicy>
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                                             const std::vector<std::string>& facet_attributes) const {
+    auto query = ParseQuery(raw_query);
+    const DocumentBitmap selected_documents = document_attributes_.Select(filter);
+    return RunWithPolicy(policy, [this, &query] { return PlanQueryExecution(query); }, [&](auto&& chosen_policy, size_t bucket_count) {
+        FacetedSearchResult result;
+        result.documents = FindAllDocuments(chosen_policy, query, BitmapSelector{selected_documents}, nullptr, bucket_count);
+
+        DocumentBitmap matched_documents;
+        for (const Document& document : result.documents) {
+            matched_documents.Add(document.id);
+        }
+        for (const std::string& attribute : facet_attributes) {
+            result.facets[attribute] = document_attributes_.CountFacet(attribute, matched_documents);
         }
+
+        KeepTopDocuments(chosen_policy, result.documents);
+        return result;
     });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate>
+auto SearchServer::MakeDocumentSelector(const DocumentPredicate& document_predicate) const {
+    return [this, &document_predicate](int document_id) {
+        const auto& document_data = documents_.at(document_id);
+        return document_predicate(document_id, document_data.status, document_data.rating);
+    };
+}
+
+template <class ExecutionPolicy, typename PlanFunction, typename Function>
+decltype(auto) SearchServer::RunWithPolicy(ExecutionPolicy&& policy, PlanFunction plan_execution, Function function) {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AutoExecutionPolicy>) {
+        const ExecutionPlan plan = plan_execution();
+        if (plan.parallelism > 1) {
+            return function(std::execution::par, std::min<size_t>(NUM_BASKET, plan.parallelism * BUCKETS_PER_TASK));
+        }
+        return function(std::execution::seq, size_t{1});
+    } else {
+        return function(policy, size_t{NUM_BASKET});
     }
+}
 
-    return matched_documents;
+template <typename Search>
+auto SearchServer::SearchInDocuments(const DocumentBitmap& documents, Search search) const {
+    // Typical collections are mostly ACTUAL, then the membership test can be skipped altogether
+    if (documents.Size() == documents_.size()) {
+        return search(AnyDocumentSelector{});
+    }
+    return search(BitmapSelector{documents});
+}
+
+template <class ExecutionPolicy>
+void SearchServer::KeepTopDocuments(ExecutionPolicy&& policy, std::vector<Document>& documents, size_t offset, size_t limit) {
+    if (offset >= documents.size()) {
+        documents.clear();
+        return;
+    }
+    // Bounded selection: only the documents up to the end of the requested range get ordered
+    const size_t ranked_count = offset + std::min(limit, documents.size() - offset);
+    partial_sort(policy, documents.begin(), documents.begin() + ranked_count, documents.end(), IsRankedHigher);
+    documents.resize(ranked_count);
+    documents.erase(documents.begin(), documents.begin() + offset);
+}
+
+template <typename Enum, typename>
+void SearchServer::SetDocumentAttribute(int document_id, std::string_view attribute, Enum value) {
+    SetDocumentAttribute(document_id, attribute, static_cast<int>(value));
 }
 
 template <class ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, 
-                            [status](int document_id,DocumentStatus document_status,int rating){
-                            return document_status == status;
-                            });
+    return SearchInDocuments(document_attributes_.GetDocuments(STATUS_ATTRIBUTE, static_cast<int>(status)), [&](auto document_selector) {
+        return FindTopDocumentsBySelector(policy, raw_query, document_selector);
+    });
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, int min_rating) const {
+    const auto selected_documents = rating_selections_.Select(document_attributes_, status, min_rating);
+    return SearchInDocuments(*selected_documents, [&](auto document_selector) {
+        return FindTopDocumentsBySelector(policy, raw_query, document_selector);
+    });
 }
 
 template <class ExecutionPolicy>
@@ -160,16 +672,65 @@ template< class ExecutionPolicy>
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const {
     auto query = ParseQuery(raw_query);
     std::vector<std::string_view> matched_words;
-    std::map<std::string_view, double> word_freq = GetWordFrequencies(document_id);
+    const WordFrequenciesView word_freq = GetWordFrequencies(document_id);
+    const auto has_prefix = [](std::string_view word, std::string_view prefix) {
+        return word.substr(0, prefix.size()) == prefix;
+    };
 
     for (std::string_view word : query.minus_words) {
         if (word_freq.count(word) > 0) {
             return { matched_words, documents_.at(document_id).status };
         }
     }
+    for (std::string_view prefix : query.minus_prefixes) {
+        for (const auto [word, _] : word_freq) {
+            if (has_prefix(word, prefix)) {
+                return { matched_words, documents_.at(document_id).status };
+            }
+        }
+    }
+    for (const auto& [word, max_distance] : query.minus_typo_words) {
+        for (const auto& [term, _] : ExpandTypos(word, max_distance)) {
+            if (word_freq.count(term) > 0) {
+                return { matched_words, documents_.at(document_id).status };
+            }
+        }
+    }
 
-    std::vector<std::string_view> plus_words(query.plus_words.begin(), query.plus_words.end());
-    matched_words = CopyIfUnordered(policy, plus_words, [&word_freq](const std::string_view& word){ return word_freq.count(word) > 0; });
+    // The query words may be stored in the query, the result refers to the dictionary instead
+    std::vector<std::string_view> plus_words;
+    for (std::string_view word : query.plus_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end()) {
+            plus_words.push_back(word_it->first);
+        }
+    }
+    // A word costs a dictionary lookup and a binary search over the document terms,
+    // every comparison about as much as scoring one posting
+    const size_t word_cost = static_cast<size_t>(std::log2(word_to_document_freqs_.size() + 1.0) + std::log2(word_freq.size() + 1.0)) + 1;
+    matched_words = RunWithPolicy(policy, [&plus_words, word_cost] { return PlanExecution(plus_words.size() * word_cost, plus_words.size()); },
+                                  [&plus_words, &word_freq](auto&& chosen_policy, size_t) {
+                                      return CopyIfUnordered(chosen_policy, plus_words, [&word_freq](const std::string_view& word){ return word_freq.count(word) > 0; });
+                                  });
+    // Only the expansions FindAllDocuments scores can match a plus prefix
+    for (std::string_view prefix : query.plus_prefixes) {
+        for (const auto* term : ExpandPrefix(prefix)) {
+            if (word_freq.count(term->first) > 0) {
+                matched_words.push_back(term->first);
+            }
+        }
+    }
+    for (const auto& [word, max_distance] : query.plus_typo_words) {
+        for (const auto& [term, _] : ExpandTypos(word, max_distance)) {
+            if (word_freq.count(term) > 0) {
+                matched_words.push_back(term);
+            }
+        }
+    }
+    if (!query.plus_prefixes.empty() || !query.plus_typo_words.empty()) {
+        sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
     // for_each(policy, plus_words.begin(), plus_words.end(), [&word_freq, &matched_words](const std::string_view& word) {
     //     if (word_freq.count(word) > 0) {
     //         matched_words.push_back(word);
@@ -179,21 +740,88 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     return { matched_words, documents_.at(document_id).status };
 }
 
-template <class ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, QueryView& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance_concurrent(NUM_BASKET);
+template <class ExecutionPolicy, typename DocumentSelector>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, QueryView& query, DocumentSelector document_selector,
+                                                     SearchContext* context, size_t bucket_count) const {
+    // Checked on the first posting of every query word and then every SEARCH_CHECK_INTERVAL postings,
+    // prefix and typo expansions check the context too
+    const auto should_stop = [context](size_t& visited_postings) {
+        return context != nullptr && visited_postings++ % SEARCH_CHECK_INTERVAL == 0 && context->CheckStop();
+    };
+    ConcurrentMap<int, double> document_to_relevance_concurrent(bucket_count);
     std::vector<std::string_view> plus_words(query.plus_words.begin(),query.plus_words.end());
-    for_each(policy, plus_words.begin(), plus_words.end(), [this, &document_predicate,&document_to_relevance_concurrent](std::string_view word){
+    for_each(policy, plus_words.begin(), plus_words.end(), [this, &document_selector, &document_to_relevance_concurrent, &should_stop](std::string_view word){
         if(word_to_document_freqs_.count(word) > 0){
             const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+            size_t visited_postings = 0;
+            for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second.document_freqs) {
+                if (should_stop(visited_postings)) {
+                    return;
+                }
+                if (document_selector(document_id)) {
                     document_to_relevance_concurrent[document_id].ref_to_value += term_freq * inverse_document_freq;
                 }
             }
         }
     });
+    // All expansions of a prefix are scored as one term: their postings are merged
+    // and the idf is taken over the merged list
+    std::vector<std::string_view> plus_prefixes(query.plus_prefixes.begin(), query.plus_prefixes.end());
+    for_each(policy, plus_prefixes.begin(), plus_prefixes.end(), [this, &document_selector, &document_to_relevance_concurrent, &should_stop, context](std::string_view prefix){
+        std::map<int, double> merged_document_freqs;
+        size_t visited_postings = 0;
+        for (const auto* term : ExpandPrefix(prefix, context)) {
+            for (const auto [document_id, term_freq] : term->second.document_freqs) {
+                if (should_stop(visited_postings)) {
+                    return;
+                }
+                merged_document_freqs[document_id] += term_freq;
+            }
+        }
+        if (merged_document_freqs.empty()) {
+            return;
+        }
+        const double inverse_document_freq = ComputeInverseDocumentFreq(merged_document_freqs.size());
+        for (const auto [document_id, term_freq] : merged_document_freqs) {
+            if (should_stop(visited_postings)) {
+                return;
+            }
+            if (document_selector(document_id)) {
+                document_to_relevance_concurrent[document_id].ref_to_value += term_freq * inverse_document_freq;
+            }
+        }
+    });
+    std::vector<std::pair<std::string_view, int>> plus_typo_words(query.plus_typo_words.begin(), query.plus_typo_words.end());
+    for_each(policy, plus_typo_words.begin(), plus_typo_words.end(), [this, &document_selector, &document_to_relevance_concurrent, &should_stop, context](const auto& typo_word){
+        const std::vector<std::pair<std::string_view, int>> expansions = ExpandTypos(typo_word.first, typo_word.second, context);
+        if (expansions.empty()) {
+            return;
+        }
+        // All expansions share the idf of the query word, so a rare misspelling never outscores
+        // the exact term. Without the exact term the most frequent expansion stands in for it
+        const auto exact_it = std::find_if(expansions.begin(), expansions.end(), [](const auto& expansion) { return expansion.second == 0; });
+        size_t document_freq = 0;
+        if (exact_it != expansions.end()) {
+            document_freq = word_to_document_freqs_.find(exact_it->first)->second.document_freqs.size();
+        } else {
+            for (const auto& [term, _] : expansions) {
+                document_freq = std::max(document_freq, word_to_document_freqs_.find(term)->second.document_freqs.size());
+            }
+        }
+        const double inverse_document_freq = ComputeInverseDocumentFreq(document_freq);
+        size_t visited_postings = 0;
+        for (const auto& [term, distance] : expansions) {
+            const double weight = std::pow(TYPO_MATCH_WEIGHT, distance);
+            for (const auto [document_id, term_freq] : word_to_document_freqs_.find(term)->second.document_freqs) {
+                if (should_stop(visited_postings)) {
+                    return;
+                }
+                if (document_selector(document_id)) {
+                    document_to_relevance_concurrent[document_id].ref_to_value += weight * term_freq * inverse_document_freq;
+                }
+            }
+        }
+    });
     std::map<int, double> document_to_relevance = document_to_relevance_concurrent.BuildOrdinaryMap();
 
     for (std::string_view word : query.minus_words) {
@@ -201,10 +829,26 @@ std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, Q
             continue;
         }
 
-        for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second) {
+        for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second.document_freqs) {
             document_to_relevance.erase(document_id);
         }
     }
+    // Unlike plus prefixes, minus prefixes are not capped: every term with the prefix excludes its documents
+    for (std::string_view prefix : query.minus_prefixes) {
+        const auto [first, last] = GetPrefixRange(prefix);
+        for (auto it = first; it != last; ++it) {
+            for (const auto [document_id, _] : it->second.document_freqs) {
+                document_to_relevance.erase(document_id);
+            }
+        }
+    }
+    for (const auto& [word, max_distance] : query.minus_typo_words) {
+        for (const auto& [term, _] : ExpandTypos(word, max_distance)) {
+            for (const auto [document_id, _] : word_to_document_freqs_.find(term)->second.document_freqs) {
+                document_to_relevance.erase(document_id);
+            }
+        }
+    }
 
     std::vector<Document> matched_documents;
     for (const auto [document_id, relevance] : document_to_relevance) {
@@ -1,11 +1,18 @@
 #pragma once
 #include "search_server.h"
 
+#include "async_search_server.h"
+#include "corpus_loader.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include <chrono>
 #include <iostream>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
@@ -197,4 +204,821 @@ int TestFindTopDocument() {
     TEST_FIND_TOP_DOC(par);
 
     return 0;
-}
\ No newline at end of file
+}
+
+string GeneratePrefixQuery(mt19937& generator, const vector<string>& dictionary, int max_prefix_length) {
+    const string& word = dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    const int length = uniform_int_distribution(1, max_prefix_length)(generator);
+    return word.substr(0, length) + '*';
+}
+
+template <typename ExecutionPolicy>
+void TestPrefix(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    size_t found = 0;
+    for (const string_view query : queries) {
+        found += search_server.FindTopDocuments(policy, query).size();
+    }
+    cout << found << endl;
+}
+
+#define TEST_FIND_PREFIX(policy) TestPrefix(#policy, search_server, queries, execution::policy)
+
+int TestFindPrefix() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1'000'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 30);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 1'000; ++i) {
+        queries.push_back(GeneratePrefixQuery(generator, dictionary, 4));
+    }
+
+    TEST_FIND_PREFIX(seq);
+    TEST_FIND_PREFIX(par);
+
+    // Only the most frequent expansion "cat" is scored, but the rare "catalog" is still excluded
+    SearchServer capped_server("and"s);
+    capped_server.AddDocument(0, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    capped_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    capped_server.AddDocument(2, "catalog and dog"s, DocumentStatus::ACTUAL, {1});
+    capped_server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, {1});
+    capped_server.SetMaxPrefixExpansionCount(1);
+    cout << capped_server.FindTopDocuments("dog -cat*"s).size() << ' '
+         << get<0>(capped_server.MatchDocument("dog -cat*"s, 2)).size() << ' '
+         << capped_server.FindTopDocuments("cat*"s).size() << ' '
+         << get<0>(capped_server.MatchDocument("cat*"s, 2)).size() << endl;
+    // 1 0 2 0
+
+    return 0;
+}
+
+string GenerateTypo(mt19937& generator, string word) {
+    const int pos = uniform_int_distribution<int>(0, word.size() - 1)(generator);
+    word[pos] = uniform_int_distribution<int>('a', 'z')(generator);
+    return word;
+}
+
+void TestTypo(string_view mark, const SearchServer& search_server, const vector<string>& queries) {
+    LOG_DURATION(mark);
+    size_t found = 0;
+    for (const string_view query : queries) {
+        found += search_server.FindTopDocuments(query).size();
+    }
+    cout << found << endl;
+}
+
+int TestFindTypo() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 100'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 30);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    {
+        LOG_DURATION("EnableTypoTolerance"s);
+        search_server.EnableTypoTolerance();
+    }
+
+    vector<string> exact_queries;
+    vector<string> typo_queries;
+    vector<string> fuzzy_queries;
+    for (int i = 0; i < 10'000; ++i) {
+        const string& word = dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+        const string typo = GenerateTypo(generator, word);
+        exact_queries.push_back(word);
+        typo_queries.push_back(typo);
+        fuzzy_queries.push_back(typo + "~1"s);
+    }
+
+    TestTypo("exact"s, search_server, exact_queries);
+    TestTypo("typo"s, search_server, typo_queries);
+    TestTypo("typo~1"s, search_server, fuzzy_queries);
+
+    // Edits are counted in characters, a Cyrillic letter takes two bytes
+    SearchServer cyrillic_server("и"s);
+    cyrillic_server.AddDocument(0, "кот и пёс"s, DocumentStatus::ACTUAL, {1});
+    cyrillic_server.AddDocument(1, "котёнок"s, DocumentStatus::ACTUAL, {1});
+    cyrillic_server.EnableTypoTolerance();
+    cout << cyrillic_server.FindTopDocuments("кт~1"s).size() << ' '
+         << cyrillic_server.FindTopDocuments("кто~1"s).size() << ' '
+         << cyrillic_server.FindTopDocuments("пес~1"s).size() << ' '
+         << cyrillic_server.FindTopDocuments("котнок~1"s).size() << endl;
+
+    // The exact term outranks a rarer neighbour one edit away
+    SearchServer ranking_server("and"s);
+    ranking_server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {1});
+    ranking_server.AddDocument(1, "cat cat dog"s, DocumentStatus::ACTUAL, {1});
+    ranking_server.AddDocument(2, "cat cat bird"s, DocumentStatus::ACTUAL, {1});
+    ranking_server.AddDocument(3, "cap"s, DocumentStatus::ACTUAL, {1});
+    ranking_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {1});
+    ranking_server.EnableTypoTolerance();
+    const auto ranked = ranking_server.FindTopDocuments("cat~1"s);
+    cout << ranked.size() << ' ' << ranked.front().id << ' ' << ranked.back().id << endl;
+    // 4 0 3
+
+    return 0;
+}
+
+int TestDeepPagination() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 50);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // Copies tie on relevance: one on the rating as well, so only the id orders them, one with a higher rating
+    const int document_count = documents.size();
+    for (int i = 0; i < document_count; i += 10) {
+        search_server.AddDocument(document_count + i, documents[i], DocumentStatus::ACTUAL, {2});
+        search_server.AddDocument(document_count * 2 + i, documents[i], DocumentStatus::ACTUAL, {3});
+    }
+
+    const string query = GenerateQuery(generator, dictionary, 5);
+    const size_t page_size = 10;
+    const size_t page_count = 100;
+    vector<Document> offset_documents;
+    {
+        LOG_DURATION("offset"s);
+        for (size_t page = 0; page < page_count; ++page) {
+            const auto documents = search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, page * page_size, page_size);
+            offset_documents.insert(offset_documents.end(), documents.begin(), documents.end());
+        }
+        cout << offset_documents.size() << endl;
+    }
+    vector<Document> cursor_documents;
+    {
+        LOG_DURATION("cursor"s);
+        optional<PageToken> after;
+        for (size_t page = 0; page < page_count; ++page) {
+            const SearchPage search_page = search_server.FindTopDocumentsPage(execution::seq, query, DocumentStatus::ACTUAL, after, page_size);
+            cursor_documents.insert(cursor_documents.end(), search_page.documents.begin(), search_page.documents.end());
+            after = search_page.next_page;
+        }
+        cout << cursor_documents.size() << endl;
+    }
+    const bool same_pages = equal(offset_documents.begin(), offset_documents.end(), cursor_documents.begin(), cursor_documents.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && lhs.rating == rhs.rating && abs(lhs.relevance - rhs.relevance) < EPSILON;
+    });
+    size_t ties = 0;
+    for (size_t i = 1; i < offset_documents.size(); ++i) {
+        ties += abs(offset_documents[i - 1].relevance - offset_documents[i].relevance) < EPSILON;
+    }
+    cout << boolalpha << same_pages << ' ' << (ties > 0) << endl;
+    // true true
+    try {
+        search_server.FindTopDocumentsPage(execution::seq, query, DocumentStatus::ACTUAL, nullopt, 0);
+    } catch (const invalid_argument& e) {
+        cout << e.what() << endl;
+    }
+    return 0;
+}
+
+int TestLoadCorpus() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 10000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 100);
+
+    string corpus;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        corpus += to_string(i) + "\tACTUAL\t1 2 3\t"s + documents[i] + '\n';
+    }
+    {
+        LOG_DURATION("AddDocument"s);
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        cout << search_server.GetDocumentCount() << endl;
+    }
+    {
+        LOG_DURATION("LoadCorpus"s);
+        SearchServer search_server(dictionary[0]);
+        istringstream input(corpus);
+        LoadCorpus(search_server, input, &cout);
+        cout << search_server.GetDocumentCount() << endl;
+    }
+    return 0;
+}
+
+template <typename Function>
+void RunInThreads(size_t thread_count, Function function) {
+    vector<thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back(function, i);
+    }
+    for (thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Requests from several threads at once. Window totals are exact, the frequent queries are
+// the heavy hitters, and a window of 100 ms buckets forgets the requests once it has passed
+int TestRequestQueue() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 1000, 10);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    const size_t thread_count = 4;
+    const size_t request_count = 2000;
+    const auto frequent_queries = GenerateQueries(generator, dictionary, HEAVY_HITTER_COUNT, 3);
+    // Every other request is a frequent query, the rest are unique; numbers are missing from the dictionary
+    vector<vector<string>> thread_queries(thread_count);
+    map<string, uint64_t> frequent_counts;
+    int no_result_count = 0;
+    for (size_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+        for (size_t i = 0; i < request_count; ++i) {
+            const string query = i % 2 == 0 ? frequent_queries[i / 2 % frequent_queries.size()]
+                : i % 3 == 0 ? to_string(thread_index * request_count + i)
+                : GenerateQuery(generator, dictionary, 2) + ' ' + to_string(thread_index * request_count + i);
+            thread_queries[thread_index].push_back(query);
+            if (i % 2 == 0) {
+                ++frequent_counts[query];
+            }
+            no_result_count += search_server.FindTopDocuments(query).empty();
+        }
+    }
+
+    RequestQueue request_queue(search_server);
+    {
+        LOG_DURATION("request queue"s);
+        RunInThreads(thread_count, [&](size_t thread_index) {
+            for (const string& query : thread_queries[thread_index]) {
+                request_queue.AddFindRequest(query);
+            }
+        });
+    }
+    const auto heavy_hitters = request_queue.GetStatistics().GetHeavyHitters();
+    const bool has_frequent_queries = heavy_hitters.size() == frequent_counts.size()
+        && all_of(heavy_hitters.begin(), heavy_hitters.end(), [&frequent_counts](const auto& heavy_hitter) {
+               // The count-min sketch may only overestimate
+               const auto it = frequent_counts.find(heavy_hitter.first);
+               return it != frequent_counts.end() && heavy_hitter.second >= it->second;
+           });
+    cout << (request_queue.GetStatistics().GetRequestCount() == thread_count * request_count)
+         << (request_queue.GetNoResultRequests() == no_result_count) << has_frequent_queries << " totals"s << endl;
+    // 111 totals
+
+    QueryStatistics statistics(chrono::milliseconds(100), 10);
+    RunInThreads(thread_count, [&statistics](size_t thread_index) {
+        for (size_t i = 0; i < request_count; ++i) {
+            statistics.AddRequest(to_string(thread_index * request_count + i), i % 4, chrono::microseconds(10));
+        }
+    });
+    const bool is_counted = statistics.GetRequestCount() == thread_count * request_count
+        && statistics.GetNoResultRequests() == static_cast<int>(thread_count * request_count / 4)
+        && statistics.GetAverageLatency() == chrono::microseconds(10);
+    this_thread::sleep_for(chrono::milliseconds(1100));
+    const bool is_expired = statistics.GetRequestCount() == 0 && statistics.GetNoResultRequests() == 0;
+    statistics.AddRequest("query"s, 0, chrono::microseconds(10));
+    const bool is_reused = statistics.GetRequestCount() == 1 && statistics.GetNoResultRequests() == 1;
+    cout << is_counted << is_expired << is_reused << " expiry"s << endl;
+    // 111 expiry
+
+    return 0;
+}
+
+template <typename ExecutionPolicy>
+void TestRemoveDuplicates(string_view mark, SearchServer search_server, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    cout << RemoveDuplicates(policy, search_server).size() << endl;
+}
+
+#define TEST_REMOVE_DUPLICATES(mode) TestRemoveDuplicates(#mode, search_server, execution::mode)
+
+int RunTestRemoveDuplicates() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 10000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 100);
+
+    SearchServer search_server(dictionary[0]);
+    int id = 0;
+    for (const string& document : documents) {
+        search_server.AddDocument(id++, document, DocumentStatus::ACTUAL, {1, 2, 3});
+        // Every fourth document gets a copy with one more word, a near duplicate
+        if (id % 4 == 0) {
+            const string& extra_word = dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+            search_server.AddDocument(id++, document + ' ' + extra_word, DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+
+    cout << search_server.GetDocumentCount() - documents.size() << " near duplicates added"s << endl;
+    TEST_REMOVE_DUPLICATES(seq);
+    TEST_REMOVE_DUPLICATES(par);
+    return 0;
+}
+
+template <typename ExecutionPolicy>
+void TestRemoveDocuments(string_view mark, SearchServer search_server, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    search_server.RemoveDocuments(policy, vector<int>(search_server.begin(), search_server.end()));
+    cout << search_server.GetDocumentCount() << endl;
+}
+
+#define TEST_REMOVE_DOCUMENTS(mode) TestRemoveDocuments("batch " #mode, search_server, execution::mode)
+
+int RunTestRemoveDocuments() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 10000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 100);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    TEST_REMOVE_DOCUMENT(seq);
+    TEST_REMOVE_DOCUMENT(par);
+    TEST_REMOVE_DOCUMENTS(seq);
+    TEST_REMOVE_DOCUMENTS(par);
+    return 0;
+}
+
+bool HasSameDocuments(const vector<Document>& documents, const vector<Document>& expected) {
+    return equal(documents.begin(), documents.end(), expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && abs(lhs.relevance - rhs.relevance) < EPSILON;
+    });
+}
+
+// Same documents, word frequencies and search results. Term ids depend on the order
+// the words were added in, so frequencies are compared by word
+bool HasSameIndex(SearchServer& search_server, SearchServer& expected, const vector<string>& queries) {
+    if (!equal(search_server.begin(), search_server.end(), expected.begin(), expected.end())) {
+        return false;
+    }
+    for (const int document_id : search_server) {
+        const auto word_freqs = search_server.GetWordFrequencies(document_id);
+        const auto expected_word_freqs = expected.GetWordFrequencies(document_id);
+        if (word_freqs.size() != expected_word_freqs.size()) {
+            return false;
+        }
+        map<string_view, double> expected_freqs(expected_word_freqs.begin(), expected_word_freqs.end());
+        for (const auto [word, freq] : word_freqs) {
+            if (word_freqs.count(word) != 1 || expected_word_freqs.count(word) != 1 || abs(expected_freqs[word] - freq) > EPSILON) {
+                return false;
+            }
+        }
+    }
+    for (const string& query : queries) {
+        if (!HasSameDocuments(search_server.FindTopDocuments(query), expected.FindTopDocuments(query))) {
+            return false;
+        }
+        for (const int document_id : {search_server.begin()[0], search_server.end()[-1]}) {
+            if (get<0>(search_server.MatchDocument(query, document_id)) != get<0>(expected.MatchDocument(query, document_id))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Removal in both forward index modes and across a mode switch, compared with
+// a server built from the remaining documents only
+int TestForwardIndex() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 3000, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 5);
+
+    SearchServer search_server(dictionary[0]);
+    SearchServer original(dictionary[0]);
+    SearchServer expected(dictionary[0]);
+    vector<int> removed_ids;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        original.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        // Two thirds of the documents are removed, more than half of the forward pool becomes garbage
+        if (i % 3 == 0) {
+            expected.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        } else {
+            removed_ids.push_back(i);
+        }
+    }
+
+    {
+        SearchServer stored = search_server;
+        for (const int document_id : removed_ids) {
+            stored.RemoveDocument(document_id);
+        }
+        cout << HasSameIndex(stored, expected, queries) << " stored"s << endl;
+        // 1 stored
+    }
+    {
+        SearchServer reconstructed = search_server;
+        reconstructed.SetForwardIndexMode(ForwardIndexMode::RECONSTRUCTED);
+        reconstructed.RemoveDocuments(execution::par, removed_ids);
+        cout << HasSameIndex(reconstructed, expected, queries) << " reconstructed"s << endl;
+        // 1 reconstructed
+    }
+    {
+        SearchServer switched = search_server;
+        const size_t half = removed_ids.size() / 2;
+        switched.RemoveDocuments(vector<int>(removed_ids.begin(), removed_ids.begin() + half));
+        switched.SetForwardIndexMode(ForwardIndexMode::RECONSTRUCTED);
+        for (size_t i = half; i < removed_ids.size(); i += 2) {
+            switched.RemoveDocument(removed_ids[i]);
+        }
+        switched.SetForwardIndexMode(ForwardIndexMode::STORED);
+        for (size_t i = half + 1; i < removed_ids.size(); i += 2) {
+            switched.RemoveDocument(execution::par, removed_ids[i]);
+        }
+        cout << HasSameIndex(switched, expected, queries) << " switched"s << endl;
+        // 1 switched
+    }
+    // The copies above did not touch the postings of the server they were copied from
+    cout << HasSameIndex(search_server, original, queries) << " original"s << endl;
+    // 1 original
+
+    return 0;
+}
+
+template <typename ExecutionPolicy, typename Search>
+void TestStatusSearch(string_view mark, const vector<string>& queries, ExecutionPolicy&& policy, Search search) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+template <typename ExecutionPolicy>
+void TestStatusSearches(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    cout << mark << endl;
+    TestStatusSearch("predicate status"s, queries, policy, [&search_server](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL;
+        });
+    });
+    TestStatusSearch("status"s, queries, policy, [&search_server](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+    });
+    TestStatusSearch("predicate status and rating"s, queries, policy, [&search_server](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, [](int, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && rating >= 3;
+        });
+    });
+    TestStatusSearch("status and rating"s, queries, policy, [&search_server](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, 3);
+    });
+}
+
+#define TEST_FIND_BY_STATUS(policy) TestStatusSearches(#policy, search_server, queries, execution::policy)
+
+int TestFindTopDocumentByStatus() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        // Nine of ten documents are ACTUAL, ratings average from 1 to 5
+        const auto status = i % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        const int rating = uniform_int_distribution<int>(1, 5)(generator);
+        search_server.AddDocument(i, documents[i], status, {rating});
+    }
+
+    const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+
+    TEST_FIND_BY_STATUS(seq);
+    TEST_FIND_BY_STATUS(par);
+
+    // One-word queries, where selecting the documents by status and rating on every call
+    // would cost more than the search itself
+    const auto short_queries = GenerateQueries(generator, dictionary, 10'000, 1);
+    const auto rating_predicate = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating >= 3;
+    };
+    TestStatusSearch("predicate status and rating, one word"s, short_queries, execution::seq, [&](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, rating_predicate);
+    });
+    TestStatusSearch("status and rating, one word"s, short_queries, execution::seq, [&search_server](auto& policy, string_view query) {
+        return search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, 3);
+    });
+
+    // The cached selection follows added and removed documents
+    for (size_t i = 0; i < documents.size(); i += 3) {
+        search_server.RemoveDocument(i);
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        const auto status = i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::IRRELEVANT;
+        search_server.AddDocument(documents.size() + i, documents[i], status, {uniform_int_distribution<int>(1, 5)(generator)});
+    }
+    cout << all_of(queries.begin(), queries.end(), [&](const string& query) {
+        return HasSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 3),
+                                search_server.FindTopDocuments(query, rating_predicate));
+    }) << " after update"s << endl;
+    // 1 after update
+
+    return 0;
+}
+
+// The bitmap against a sorted set of the same ids, spread over several 2^16 containers
+bool TestDocumentBitmap(mt19937& generator, size_t count) {
+    DocumentBitmap lhs, rhs;
+    set<int> lhs_ids, rhs_ids;
+    for (size_t i = 0; i < count; ++i) {
+        const int lhs_id = uniform_int_distribution<int>(0, 200'000)(generator);
+        const int rhs_id = uniform_int_distribution<int>(0, 200'000)(generator);
+        lhs.Add(lhs_id);
+        lhs_ids.insert(lhs_id);
+        rhs.Add(rhs_id);
+        rhs_ids.insert(rhs_id);
+        if (i % 3 == 0) {
+            lhs.Remove(rhs_id);
+            lhs_ids.erase(rhs_id);
+        }
+    }
+    vector<int> intersection, united;
+    set_intersection(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(), back_inserter(intersection));
+    set_union(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(), back_inserter(united));
+
+    vector<int> lhs_values, intersection_values, united_values;
+    lhs.ForEach([&lhs_values](int id) { lhs_values.push_back(id); });
+    (lhs & rhs).ForEach([&intersection_values](int id) { intersection_values.push_back(id); });
+    (lhs | rhs).ForEach([&united_values](int id) { united_values.push_back(id); });
+    return lhs.Size() == lhs_ids.size() && equal(lhs_values.begin(), lhs_values.end(), lhs_ids.begin(), lhs_ids.end())
+        && lhs.CountIntersection(rhs) == intersection.size() && intersection_values == intersection && united_values == united
+        && all_of(rhs_ids.begin(), rhs_ids.end(), [&rhs](int id) { return rhs.Contains(id); });
+}
+
+// Filtered and faceted searches against the same conditions written as predicates
+template <typename DocumentPredicate>
+bool TestDocumentFilter(const SearchServer& search_server, const vector<string>& queries, const DocumentFilter& filter,
+                        DocumentPredicate document_predicate, const vector<int>& categories) {
+    for (const string& query : queries) {
+        if (!HasSameDocuments(search_server.FindTopDocuments(query, filter), search_server.FindTopDocuments(query, document_predicate))) {
+            return false;
+        }
+        const FacetedSearchResult result = search_server.FindTopDocumentsWithFacets(query, filter, {"category"s, STATUS_ATTRIBUTE});
+        const auto all_documents = search_server.FindTopDocuments(execution::seq, query, document_predicate, 0, categories.size());
+        map<int, size_t> category_counts, status_counts;
+        for (const Document& document : all_documents) {
+            ++category_counts[categories[document.id]];
+            ++status_counts[static_cast<int>(get<1>(search_server.MatchDocument(query, document.id)))];
+        }
+        if (!HasSameDocuments(result.documents, search_server.FindTopDocuments(query, document_predicate))
+            || result.facets.at("category"s) != category_counts || result.facets.at(STATUS_ATTRIBUTE) != status_counts) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int TestFindTopDocumentByFilter() {
+    mt19937 generator;
+
+    cout << TestDocumentBitmap(generator, 100) << TestDocumentBitmap(generator, 100'000) << " bitmap"s << endl;
+    // 11 bitmap
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 5000, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 5);
+
+    SearchServer search_server(dictionary[0]);
+    vector<int> categories(documents.size());
+    vector<int> years(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto status = static_cast<DocumentStatus>(uniform_int_distribution<int>(0, 3)(generator));
+        search_server.AddDocument(i, documents[i], status, {uniform_int_distribution<int>(-5, 5)(generator)});
+        categories[i] = uniform_int_distribution<int>(0, 9)(generator);
+        years[i] = uniform_int_distribution<int>(2000, 2023)(generator);
+        search_server.SetDocumentAttribute(i, "category"s, categories[i]);
+        search_server.SetDocumentAttribute(i, "year"s, years[i]);
+    }
+    // Removed documents must leave the attribute bitmaps too
+    for (size_t i = 0; i < documents.size(); i += 7) {
+        search_server.RemoveDocument(i);
+    }
+
+    cout << TestDocumentFilter(search_server, queries, DocumentFilter().Where("category"s, 3),
+                               [&categories](int document_id, DocumentStatus, int) {
+                                   return categories[document_id] == 3;
+                               }, categories)
+         << TestDocumentFilter(search_server, queries, DocumentFilter().WhereIn("category"s, {1, 4, 7}).WithStatus(DocumentStatus::BANNED),
+                               [&categories](int document_id, DocumentStatus status, int) {
+                                   const int category = categories[document_id];
+                                   return (category == 1 || category == 4 || category == 7) && status == DocumentStatus::BANNED;
+                               }, categories)
+         << TestDocumentFilter(search_server, queries, DocumentFilter().WhereBetween("year"s, 2005, 2010).WithRatingBetween(0, 3),
+                               [&years](int document_id, DocumentStatus, int rating) {
+                                   return years[document_id] >= 2005 && years[document_id] <= 2010 && rating >= 0 && rating <= 3;
+                               }, categories)
+         << TestDocumentFilter(search_server, queries,
+                               DocumentFilter().WithStatuses({DocumentStatus::ACTUAL, DocumentStatus::REMOVED}).Where("year"s, 2020),
+                               [&years](int document_id, DocumentStatus status, int) {
+                                   return (status == DocumentStatus::ACTUAL || status == DocumentStatus::REMOVED) && years[document_id] == 2020;
+                               }, categories)
+         << " filter"s << endl;
+    // 1111 filter
+
+    return 0;
+}
+
+void TestAsyncSearch(string_view mark, const SearchServer& search_server, const vector<string>& queries,
+                     chrono::steady_clock::duration timeout) {
+    LOG_DURATION(mark);
+    AsyncSearchServer async_search_server(search_server);
+    vector<AsyncSearch> searches;
+    searches.reserve(queries.size());
+    for (const string& query : queries) {
+        searches.push_back(async_search_server.FindTopDocuments(query, timeout));
+    }
+    size_t partial_count = 0;
+    double total_relevance = 0;
+    for (AsyncSearch& search : searches) {
+        const SearchResult result = search.result.get();
+        partial_count += result.is_partial;
+        for (const Document& document : result.documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << partial_count << " of "s << queries.size() << " partial, total relevance "s << total_relevance << endl;
+}
+
+// Load generator: a burst of long queries over common words, with and without a deadline
+int TestFindTopDocumentAsync() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    const auto queries = GenerateQueries(generator, dictionary, 500, 70);
+
+    TestAsyncSearch("no deadline"s, search_server, queries, chrono::hours(1));
+    TestAsyncSearch("deadline 100 ms"s, search_server, queries, chrono::milliseconds(100));
+    TestAsyncSearch("deadline 10 ms"s, search_server, queries, chrono::milliseconds(10));
+
+    {
+        AsyncSearchServer async_search_server(search_server);
+        AsyncSearch search = async_search_server.FindTopDocuments(queries[0], chrono::hours(1));
+        search.Cancel();
+        cout << "cancelled query partial: "s << search.result.get().is_partial << endl;
+    }
+
+    // Prefix and typo words over a large dictionary: an expired deadline stops the expansions
+    // themselves, not only the posting loops after them
+    {
+        const auto expansion_dictionary = GenerateDictionary(generator, 20'000, 10);
+        const auto expansion_documents = GenerateQueries(generator, expansion_dictionary, 10'000, 20);
+        SearchServer expansion_server(expansion_dictionary[0]);
+        for (size_t i = 0; i < expansion_documents.size(); ++i) {
+            expansion_server.AddDocument(i, expansion_documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        expansion_server.EnableTypoTolerance();
+        expansion_server.SetMaxPrefixExpansionCount(expansion_dictionary.size());
+        vector<string> expansion_queries;
+        for (int i = 0; i < 200; ++i) {
+            const string& word = expansion_dictionary[uniform_int_distribution<int>(0, expansion_dictionary.size() - 1)(generator)];
+            expansion_queries.push_back(GeneratePrefixQuery(generator, expansion_dictionary, 1) + ' ' + GenerateTypo(generator, word) + "~2"s);
+        }
+        TestAsyncSearch("expansions, no deadline"s, expansion_server, expansion_queries, chrono::hours(1));
+        TestAsyncSearch("expansions, expired deadline"s, expansion_server, expansion_queries, chrono::nanoseconds(0));
+    }
+
+    return 0;
+}
+
+// Russian words, every fourth one capitalized and some followed by a comma
+string GenerateCyrillicWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    const bool is_capitalized = uniform_int_distribution(0, 3)(generator) == 0;
+    string word;
+    for (int i = 0; i < length; ++i) {
+        // а..я is U+0430..U+044F, А..Я is U+0410..U+042F
+        const char32_t letter = (i == 0 && is_capitalized ? 0x410 : 0x430) + uniform_int_distribution<int>(0, 31)(generator);
+        word.push_back(static_cast<char>(0xC0 | (letter >> 6)));
+        word.push_back(static_cast<char>(0x80 | (letter & 0x3F)));
+    }
+    if (uniform_int_distribution(0, 7)(generator) == 0) {
+        word.push_back(',');
+    }
+    return word;
+}
+
+int TestNormalizeText() {
+    mt19937 generator;
+
+    vector<string> dictionary;
+    for (int i = 0; i < 10'000; ++i) {
+        dictionary.push_back(GenerateCyrillicWord(generator, 10));
+    }
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 70);
+    size_t total_size = 0;
+    for (const string& document : documents) {
+        total_size += document.size();
+    }
+    cout << total_size / (1 << 20) << " MB of Cyrillic text"s << endl;
+
+    {
+        LOG_DURATION("SplitIntoWords"s);
+        size_t word_count = 0;
+        for (const string& document : documents) {
+            word_count += SplitIntoWords(document).size();
+        }
+        cout << word_count << endl;
+    }
+    {
+        LOG_DURATION("NormalizeText"s);
+        size_t word_count = 0;
+        for (const string& document : documents) {
+            word_count += NormalizeText(document).words.size();
+        }
+        cout << word_count << endl;
+    }
+    for (const Stemming stemming : {Stemming::NONE, Stemming::LIGHT}) {
+        SearchServer search_server("и в на"s, stemming);
+        {
+            LOG_DURATION(stemming == Stemming::NONE ? "AddDocument"s : "AddDocument with stemming"s);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+    }
+
+    return 0;
+}
+
+template <typename ExecutionPolicy>
+void TestPolicy(string_view mark, SearchServer search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    size_t matched_words = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+        matched_words += get<0>(search_server.MatchDocument(policy, query, 0)).size();
+    }
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        search_server.RemoveDocument(policy, document_id);
+    }
+    cout << total_relevance << ' ' << matched_words << endl;
+}
+
+#define TEST_POLICY(mark, policy) TestPolicy(mark, search_server, queries, policy)
+
+// Small and large queries over the same server with seq, par and the automatic choice
+int TestAutoExecution() {
+    mt19937 generator;
+
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    cout << "parallel from "s << GetParallelCostThreshold() << " postings"s << endl;
+
+    for (const int word_count : {1, 70}) {
+        const auto queries = GenerateQueries(generator, dictionary, 100, word_count);
+        cout << word_count << " words per query"s << endl;
+        TEST_POLICY("seq"s, execution::seq);
+        TEST_POLICY("par"s, execution::par);
+        TEST_POLICY("auto"s, AUTO_EXECUTION);
+    }
+    {
+        // Prefixes are costed by the posting lists of their most frequent expansions
+        vector<string> queries;
+        for (int i = 0; i < 100; ++i) {
+            queries.push_back(GeneratePrefixQuery(generator, dictionary, 2));
+        }
+        cout << "prefix queries"s << endl;
+        TEST_POLICY("seq"s, execution::seq);
+        TEST_POLICY("par"s, execution::par);
+        TEST_POLICY("auto"s, AUTO_EXECUTION);
+    }
+
+    return 0;
+}
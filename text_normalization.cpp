@@ -0,0 +1,241 @@
+#include "text_normalization.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+enum CharClass : uint8_t {
+    WORD_CHAR,
+    UPPER_CHAR,
+    SEPARATOR_CHAR,
+    CONTROL_CHAR,
+};
+
+// Lower case of ASCII, Latin-1 and Cyrillic capitals, both cases take the same number of bytes in UTF-8
+static constexpr char32_t FoldCase(char32_t code_point) {
+    if ((code_point >= 'A' && code_point <= 'Z') || (code_point >= 0xC0 && code_point <= 0xDE && code_point != 0xD7)
+        || (code_point >= 0x410 && code_point <= 0x42F)) {
+        return code_point + 0x20;
+    }
+    if (code_point >= 0x400 && code_point <= 0x40F) {
+        return code_point + 0x50;
+    }
+    return code_point;
+}
+
+// ASCII punctuation, Latin-1 punctuation and symbols, general punctuation, ideographic space and BOM
+static constexpr bool IsSeparator(char32_t code_point) {
+    if (code_point < 0x80) {
+        return !((code_point >= 'a' && code_point <= 'z') || (code_point >= 'A' && code_point <= 'Z') || (code_point >= '0' && code_point <= '9'));
+    }
+    return (code_point >= 0xA0 && code_point <= 0xBF && code_point != 0xAA && code_point != 0xB5 && code_point != 0xBA)
+        || code_point == 0xD7 || code_point == 0xF7 || (code_point >= 0x2000 && code_point <= 0x206F)
+        || code_point == 0x3000 || code_point == 0xFEFF;
+}
+
+static constexpr CharClass ClassifyCharacter(char32_t code_point) {
+    if (code_point < ' ' || (code_point >= 0x7F && code_point < 0xA0)) {
+        return code_point == 0x7F ? SEPARATOR_CHAR : CONTROL_CHAR;
+    }
+    if (IsSeparator(code_point)) {
+        return SEPARATOR_CHAR;
+    }
+    return FoldCase(code_point) != code_point ? UPPER_CHAR : WORD_CHAR;
+}
+
+// Classes of all one and two byte characters: ASCII, Latin-1, Cyrillic and the rest below U+0800
+static constexpr std::array<uint8_t, 0x800> MakeCharacterClasses() {
+    std::array<uint8_t, 0x800> classes{};
+    for (char32_t code_point = 0; code_point < classes.size(); ++code_point) {
+        classes[code_point] = ClassifyCharacter(code_point);
+    }
+    return classes;
+}
+
+// Byte length of a UTF-8 sequence by its first byte, 0 for continuation bytes and
+// bytes that never start a valid sequence (overlong C0, C1 and beyond U+10FFFF)
+static constexpr std::array<uint8_t, 256> MakeSequenceLengths() {
+    std::array<uint8_t, 256> lengths{};
+    for (int byte = 0; byte < 256; ++byte) {
+        if (byte < 0x80) {
+            lengths[byte] = 1;
+        } else if (byte >= 0xC2 && byte <= 0xDF) {
+            lengths[byte] = 2;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            lengths[byte] = 3;
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            lengths[byte] = 4;
+        }
+    }
+    return lengths;
+}
+
+static constexpr std::array<uint8_t, 0x800> CHARACTER_CLASSES = MakeCharacterClasses();
+static constexpr std::array<uint8_t, 256> SEQUENCE_LENGTHS = MakeSequenceLengths();
+
+static bool IsAsciiBlock(const char* data) {
+    uint64_t block;
+    std::memcpy(&block, data, sizeof(block));
+    return (block & 0x8080808080808080ULL) == 0;
+}
+
+// Decodes the character at pos, returns its length or 0 if it is malformed
+static size_t DecodeCharacter(std::string_view text, size_t pos, char32_t& code_point) {
+    static constexpr uint8_t LEAD_MASKS[] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+    static constexpr char32_t MIN_CODE_POINTS[] = {0, 0, 0x80, 0x800, 0x10000};
+
+    const auto lead = static_cast<uint8_t>(text[pos]);
+    const size_t length = SEQUENCE_LENGTHS[lead];
+    if (length == 0 || text.size() - pos < length) {
+        return 0;
+    }
+    code_point = lead & LEAD_MASKS[length];
+    for (size_t i = 1; i < length; ++i) {
+        const auto byte = static_cast<uint8_t>(text[pos + i]);
+        if ((byte & 0xC0) != 0x80) {
+            return 0;
+        }
+        code_point = (code_point << 6) | (byte & 0x3F);
+    }
+    if (code_point < MIN_CODE_POINTS[length] || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+// Writes the case-folded word to output, the word is already validated
+static void FoldWord(std::string_view word, char* output) {
+    for (size_t pos = 0; pos < word.size();) {
+        char32_t code_point = 0;
+        const size_t length = DecodeCharacter(word, pos, code_point);
+        const char32_t folded = FoldCase(code_point);
+        if (folded == code_point) {
+            std::memcpy(output + pos, word.data() + pos, length);
+        } else if (length == 1) {
+            output[pos] = static_cast<char>(folded);
+        } else {
+            output[pos] = static_cast<char>(0xC0 | (folded >> 6));
+            output[pos + 1] = static_cast<char>(0x80 | (folded & 0x3F));
+        }
+        pos += length;
+    }
+}
+
+NormalizedText NormalizeText(std::string_view text) {
+    NormalizedText result;
+    size_t buffer_size = 0;
+    bool in_word = false;
+    bool is_changed = false;
+    size_t word_begin = 0;
+
+    const auto begin_word = [&](size_t pos) {
+        if (!in_word) {
+            in_word = true;
+            word_begin = pos;
+        }
+    };
+    const auto end_word = [&](size_t pos) {
+        if (!in_word) {
+            return;
+        }
+        in_word = false;
+        const std::string_view word = text.substr(word_begin, pos - word_begin);
+        if (!is_changed) {
+            result.words.push_back(word);
+            return;
+        }
+        // Folding keeps the length, so the buffer never outgrows the text
+        if (!result.buffer) {
+            result.buffer = std::make_unique<char[]>(text.size());
+        }
+        char* folded_word = result.buffer.get() + buffer_size;
+        FoldWord(word, folded_word);
+        result.words.push_back({folded_word, word.size()});
+        buffer_size += word.size();
+        is_changed = false;
+    };
+    const auto add_character = [&](size_t pos, uint8_t character_class) {
+        switch (character_class) {
+        case WORD_CHAR:
+            begin_word(pos);
+            break;
+        case UPPER_CHAR:
+            begin_word(pos);
+            is_changed = true;
+            break;
+        case SEPARATOR_CHAR:
+            end_word(pos);
+            break;
+        default:
+            throw std::invalid_argument("Text contains control characters"s);
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // Eight bytes without the high bit are valid ASCII and need no decoding
+        if (text.size() - pos >= 8 && IsAsciiBlock(text.data() + pos)) {
+            for (const size_t block_end = pos + 8; pos < block_end; ++pos) {
+                add_character(pos, CHARACTER_CLASSES[static_cast<uint8_t>(text[pos])]);
+            }
+            continue;
+        }
+        const auto lead = static_cast<uint8_t>(text[pos]);
+        if (lead < 0x80) {
+            add_character(pos, CHARACTER_CLASSES[lead]);
+            ++pos;
+            continue;
+        }
+        // Two-byte sequences (Cyrillic, Latin-1) are decoded inline, C2..DF leads are never overlong
+        if (lead >= 0xC2 && lead <= 0xDF && text.size() - pos >= 2 && (static_cast<uint8_t>(text[pos + 1]) & 0xC0) == 0x80) {
+            add_character(pos, CHARACTER_CLASSES[((lead & 0x1F) << 6) | (static_cast<uint8_t>(text[pos + 1]) & 0x3F)]);
+            pos += 2;
+            continue;
+        }
+        char32_t code_point = 0;
+        const size_t length = DecodeCharacter(text, pos, code_point);
+        if (length == 0) {
+            throw std::invalid_argument("Text is not valid UTF-8"s);
+        }
+        add_character(pos, ClassifyCharacter(code_point));
+        pos += length;
+    }
+    end_word(text.size());
+    return result;
+}
+
+// Nominal and adjectival inflections, longer endings first
+static const std::string_view RUSSIAN_ENDINGS[] = {
+    "иями", "ями", "ами", "ией", "иям", "ием", "иях", "ого", "его", "ому", "ему", "ыми", "ими",
+    "ев", "ов", "ие", "ье", "еи", "ии", "ей", "ой", "ий", "ый", "ям", "ем", "ам", "ом", "ах", "ях",
+    "ию", "ью", "ия", "ья", "ая", "яя", "ое", "ее", "ые", "ую", "юю", "ым", "им",
+    "а", "е", "и", "й", "о", "у", "ы", "ь", "ю", "я",
+};
+// Two Cyrillic letters
+static const size_t MIN_RUSSIAN_STEM_SIZE = 4;
+static const size_t MIN_ENGLISH_STEM_SIZE = 3;
+
+std::string_view StemWord(std::string_view word) {
+    if (word.size() < 2) {
+        return word;
+    }
+    const auto last_lead = static_cast<uint8_t>(word[word.size() - 2]);
+    if (last_lead == 0xD0 || last_lead == 0xD1) {
+        for (std::string_view ending : RUSSIAN_ENDINGS) {
+            if (word.size() >= MIN_RUSSIAN_STEM_SIZE + ending.size() && word.substr(word.size() - ending.size()) == ending) {
+                return word.substr(0, word.size() - ending.size());
+            }
+        }
+        return word;
+    }
+    // English plural, but not "class", "bus" or "this"
+    const char before_last = word[word.size() - 2];
+    if (word.size() > MIN_ENGLISH_STEM_SIZE && word.back() == 's' && before_last != 's' && before_last != 'u' && before_last != 'i') {
+        word.remove_suffix(1);
+    }
+    return word;
+}
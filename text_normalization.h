@@ -0,0 +1,24 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+
+enum class Stemming {
+    NONE,
+    // Strips common Russian inflections and the English plural "s"
+    LIGHT,
+};
+
+struct NormalizedText {
+    std::vector<std::string_view> words;
+    // Words changed by case folding are stored here, the others point into the source text
+    std::unique_ptr<char[]> buffer;
+};
+
+// Splits UTF-8 text into case-folded words. Whitespace and punctuation separate words.
+// Folding covers ASCII, Latin-1 and Cyrillic letters and keeps the byte length of the word.
+// Throws invalid_argument on malformed UTF-8 and control characters
+NormalizedText NormalizeText(std::string_view text);
+
+// Light suffix-stripping stemmer for case-folded words, the stem is a prefix of the word
+std::string_view StemWord(std::string_view word);